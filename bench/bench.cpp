@@ -0,0 +1,159 @@
+#include "bench.h"
+
+#include <time.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace {
+
+bool g_counting = false;
+unsigned long g_alloc_count = 0;
+unsigned long g_alloc_bytes = 0;
+
+std::vector<bench::BenchCase>& Cases() {
+  static std::vector<bench::BenchCase> cases;
+  return cases;
+}
+
+double NowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+}
+
+void* CountedAlloc(std::size_t size) {
+  if (g_counting) {
+    ++g_alloc_count;
+    g_alloc_bytes += size;
+  }
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+std::string EscapeJson(const std::string& str) {
+  std::string escaped;
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it) {
+    if (*it == '"' || *it == '\\') {
+      escaped += '\\';
+    }
+    escaped += *it;
+  }
+  return escaped;
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) throw(std::bad_alloc) {
+  return CountedAlloc(size);
+}
+
+void* operator new[](std::size_t size) throw(std::bad_alloc) {
+  return CountedAlloc(size);
+}
+
+void operator delete(void* ptr) throw() { std::free(ptr); }
+
+void operator delete[](void* ptr) throw() { std::free(ptr); }
+
+namespace bench {
+
+volatile const void* g_sink;
+
+void DoNotOptimize(const void* value) { g_sink = value; }
+
+void Register(const std::string& name, BenchFunction function, void* context) {
+  BenchCase bench_case;
+  bench_case.name = name;
+  bench_case.function = function;
+  bench_case.context = context;
+  Cases().push_back(bench_case);
+}
+
+const std::vector<BenchCase>& GetCases() { return Cases(); }
+
+BenchResult Run(const BenchCase& bench_case, double min_seconds) {
+  unsigned long iterations = 1;
+  double elapsed = 0;
+
+  bench_case.function(bench_case.context, 1);
+  while (true) {
+    g_alloc_count = 0;
+    g_alloc_bytes = 0;
+    g_counting = true;
+    double start = NowNs();
+    bench_case.function(bench_case.context, iterations);
+    elapsed = NowNs() - start;
+    g_counting = false;
+
+    if (elapsed >= min_seconds * 1e9 || iterations >= 1000000000UL) {
+      break;
+    }
+    unsigned long next = iterations * 10;
+    if (elapsed > 0) {
+      next = static_cast<unsigned long>(iterations * (min_seconds * 1.2e9 / elapsed));
+      if (next > iterations * 100) next = iterations * 100;
+      if (next <= iterations) next = iterations + 1;
+    }
+    iterations = next;
+  }
+
+  BenchResult result;
+  result.name = bench_case.name;
+  result.iterations = iterations;
+  result.ns_per_op = elapsed / iterations;
+  result.allocs_per_op = static_cast<double>(g_alloc_count) / iterations;
+  result.bytes_per_op = static_cast<double>(g_alloc_bytes) / iterations;
+  return result;
+}
+
+void PrintJson(const std::vector<BenchResult>& results) {
+  std::cout << "[\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    std::cout << "  {\"name\": \"" << EscapeJson(r.name) << "\""
+              << ", \"iterations\": " << r.iterations
+              << ", \"ns_per_op\": " << r.ns_per_op
+              << ", \"allocs_per_op\": " << r.allocs_per_op
+              << ", \"bytes_per_op\": " << r.bytes_per_op << "}"
+              << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  std::cout << "]" << std::endl;
+}
+
+}  // namespace bench
+
+int main(int argc, char** argv) {
+  double min_seconds = 0.2;
+  std::string filter;
+
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+      min_seconds = std::atof(argv[++i]);
+    } else {
+      filter = argv[i];
+    }
+  }
+
+  bench::RegisterParserCases();
+  bench::RegisterRoutingCases();
+  bench::RegisterResponseCases();
+  bench::RegisterUtilCases();
+  bench::RegisterCgiCases();
+
+  std::vector<bench::BenchResult> results;
+  const std::vector<bench::BenchCase>& cases = bench::GetCases();
+  for (std::vector<bench::BenchCase>::const_iterator it = cases.begin();
+       it != cases.end(); ++it) {
+    if (!filter.empty() && it->name.find(filter) == std::string::npos) {
+      continue;
+    }
+    results.push_back(bench::Run(*it, min_seconds));
+  }
+  bench::PrintJson(results);
+  return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef WEBSERV_BENCH_BENCH_H_
+#define WEBSERV_BENCH_BENCH_H_
+
+#include <string>
+#include <vector>
+
+namespace bench {
+
+typedef void (*BenchFunction)(void* context, unsigned long iterations);
+
+struct BenchCase {
+  std::string name;
+  BenchFunction function;
+  void* context;
+};
+
+struct BenchResult {
+  std::string name;
+  unsigned long iterations;
+  double ns_per_op;
+  double allocs_per_op;
+  double bytes_per_op;
+};
+
+void Register(const std::string& name, BenchFunction function, void* context);
+const std::vector<BenchCase>& GetCases();
+
+BenchResult Run(const BenchCase& bench_case, double min_seconds);
+void PrintJson(const std::vector<BenchResult>& results);
+
+// Keeps the optimizer from discarding results of the measured code.
+void DoNotOptimize(const void* value);
+
+void RegisterParserCases();
+void RegisterRoutingCases();
+void RegisterResponseCases();
+void RegisterUtilCases();
+void RegisterCgiCases();
+
+}  // namespace bench
+
+#endif  // WEBSERV_BENCH_BENCH_H_
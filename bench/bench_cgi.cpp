@@ -0,0 +1,94 @@
+#include "bench.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+
+#include "../inc/Cgi/cgi_handler.h"
+
+namespace {
+
+struct SpawnContext {
+  std::size_t resident_bytes;
+};
+
+char* g_ballast = NULL;
+std::size_t g_ballast_size = 0;
+
+// Grows or shrinks a touched anonymous mapping so the process has the given
+// amount of extra resident memory. Runs in the untimed warm-up call, since
+// every case after the first sees the size already in place.
+void EnsureResident(std::size_t bytes) {
+  if (bytes == g_ballast_size) {
+    return;
+  }
+  if (g_ballast != NULL) {
+    munmap(g_ballast, g_ballast_size);
+    g_ballast = NULL;
+    g_ballast_size = 0;
+  }
+  if (bytes == 0) {
+    return;
+  }
+  void* mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    std::abort();
+  }
+  g_ballast = static_cast<char*>(mapping);
+  g_ballast_size = bytes;
+  std::memset(g_ballast, 1, bytes);
+}
+
+char* g_argv[] = {const_cast<char*>("/bin/true"), NULL};
+char* g_env[] = {NULL};
+
+// The launch CGI requests used before posix_spawn: fork the whole server,
+// then exec in the child.
+void ForkExec(void* context, unsigned long iterations) {
+  EnsureResident(static_cast<SpawnContext*>(context)->resident_bytes);
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      execve(g_argv[0], g_argv, g_env);
+      _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+  }
+}
+
+void PosixSpawn(void* context, unsigned long iterations) {
+  EnsureResident(static_cast<SpawnContext*>(context)->resident_bytes);
+
+  int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+  int fds[3] = {null_fd, null_fd, null_fd};
+  for (unsigned long i = 0; i < iterations; ++i) {
+    pid_t pid = CgiHandler::SpawnScript(g_argv[0], "/", g_env, fds);
+    waitpid(pid, NULL, 0);
+  }
+  close(null_fd);
+}
+
+SpawnContext* MakeSpawnContext(std::size_t megabytes) {
+  SpawnContext* context = new SpawnContext();
+  context->resident_bytes = megabytes * 1024 * 1024;
+  return context;
+}
+
+}  // namespace
+
+namespace bench {
+
+void RegisterCgiCases() {
+  Register("cgi/spawn/fork_exec/rss_16MB", ForkExec, MakeSpawnContext(16));
+  Register("cgi/spawn/fork_exec/rss_256MB", ForkExec, MakeSpawnContext(256));
+  Register("cgi/spawn/fork_exec/rss_1GB", ForkExec, MakeSpawnContext(1024));
+  Register("cgi/spawn/posix_spawn/rss_16MB", PosixSpawn, MakeSpawnContext(16));
+  Register("cgi/spawn/posix_spawn/rss_256MB", PosixSpawn, MakeSpawnContext(256));
+  Register("cgi/spawn/posix_spawn/rss_1GB", PosixSpawn, MakeSpawnContext(1024));
+}
+
+}  // namespace bench
@@ -0,0 +1,116 @@
+#include "bench.h"
+
+#include "../inc/Config/http_config.h"
+#include "../inc/Request/request_parser.h"
+
+namespace {
+
+const char kBrowserGet[] =
+    "GET /static/css/site.css?v=20250419 HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Referer: http://example.com/index.html\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=6a1f0c2e9b7d4e3f8a5c; theme=dark\r\n"
+    "If-Modified-Since: Sat, 19 Apr 2025 10:00:00 GMT\r\n"
+    "\r\n";
+
+const char kFormPost[] =
+    "POST /cgi-bin/form.php HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 46\r\n"
+    "\r\n"
+    "name=webserv&comment=hello%20world&submit=Send";
+
+const char kChunkedPost[] =
+    "POST /uploads HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Content-Type: text/plain\r\n"
+    "\r\n"
+    "1a\r\nabcdefghijklmnopqrstuvwxyz\r\n"
+    "10\r\n0123456789abcdef\r\n"
+    "0\r\n\r\n";
+
+struct ParserContext {
+  HttpConfig* config;
+  std::string request;
+  std::vector<std::string> pieces;
+};
+
+HttpConfig* BuildParserConfig() {
+  HttpConfig* config = new HttpConfig();
+  ServerConfig* server = new ServerConfig(config);
+  server->AddListenDirective("0.0.0.0", 8080);
+  server->AddServerName("example.com");
+  const char* paths[] = {"/", "/static/", "/cgi-bin/", "/uploads"};
+  for (std::size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+    LocationConfig* location = new LocationConfig(server);
+    location->SetPath(paths[i]);
+    server->AddLocation(location);
+  }
+  config->AddServer(server);
+  return config;
+}
+
+void ConsumePieces(void* context, unsigned long iterations) {
+  ParserContext* ctx = static_cast<ParserContext*>(context);
+  RequestParser parser(ctx->config->GetServers()[0]);
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    for (std::size_t j = 0; j < ctx->pieces.size(); ++j) {
+      parser.Consume(ctx->pieces[j]);
+    }
+    bench::DoNotOptimize(&parser.GetRequest());
+    parser.Reset();
+  }
+}
+
+ParserContext* MakeContext(HttpConfig* config, const std::string& request,
+                           const std::string& mode) {
+  ParserContext* ctx = new ParserContext();
+  ctx->config = config;
+  ctx->request = request;
+
+  if (mode == "whole") {
+    ctx->pieces.push_back(request);
+  } else if (mode == "bytewise") {
+    for (std::size_t i = 0; i < request.length(); ++i) {
+      ctx->pieces.push_back(request.substr(i, 1));
+    }
+  } else {
+    unsigned long seed = 42;
+    std::size_t pos = 0;
+    while (pos < request.length()) {
+      seed = seed * 1103515245UL + 12345UL;
+      std::size_t len = 1 + (seed >> 16) % 64;
+      ctx->pieces.push_back(request.substr(pos, len));
+      pos += len;
+    }
+  }
+  return ctx;
+}
+
+}  // namespace
+
+namespace bench {
+
+void RegisterParserCases() {
+  static HttpConfig* config = BuildParserConfig();
+  const char* modes[] = {"whole", "bytewise", "random_split"};
+  const char* names[] = {"browser_get", "form_post", "chunked_post"};
+  const char* requests[] = {kBrowserGet, kFormPost, kChunkedPost};
+
+  for (std::size_t r = 0; r < 3; ++r) {
+    for (std::size_t m = 0; m < 3; ++m) {
+      Register(std::string("parser/") + names[r] + "/" + modes[m], ConsumePieces,
+               MakeContext(config, requests[r], modes[m]));
+    }
+  }
+}
+
+}  // namespace bench
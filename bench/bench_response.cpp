@@ -0,0 +1,96 @@
+#include "bench.h"
+
+#include "../inc/Response/http_response.h"
+#include "../inc/Response/mime_type.h"
+
+namespace {
+
+struct ResponseContext {
+  HttpResponse response;
+};
+
+void ResponseToString(void* context, unsigned long iterations) {
+  ResponseContext* ctx = static_cast<ResponseContext*>(context);
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    std::string serialized = ctx->response.ToString();
+    bench::DoNotOptimize(serialized.data());
+  }
+}
+
+void ResponseAppendHead(void* context, unsigned long iterations) {
+  ResponseContext* ctx = static_cast<ResponseContext*>(context);
+  std::string head;
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    head.clear();
+    ctx->response.AppendHead(&head);
+    bench::DoNotOptimize(head.data());
+  }
+}
+
+// Splits a CGI-sized output into headers and a body slice the way the CGI
+// response path does.
+void ChainSliceBody(void* context, unsigned long iterations) {
+  const BufferChain* output = static_cast<const BufferChain*>(context);
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    std::size_t header_end = output->Find("\r\n\r\n");
+    BufferChain body = output->Slice(header_end + 4);
+    bench::DoNotOptimize(&body);
+  }
+}
+
+BufferChain* MakeCgiOutput(std::size_t body_size) {
+  BufferChain* output = new BufferChain();
+  std::string headers = "Content-Type: text/plain\r\nX-Test: yes\r\n\r\n";
+  output->Append(headers.data(), headers.size());
+  std::string line(4096, 'x');
+  for (std::size_t written = 0; written < body_size; written += line.size()) {
+    output->Append(line.data(), line.size());
+  }
+  return output;
+}
+
+void GetMimeType(void* context, unsigned long iterations) {
+  const std::vector<std::string>* extensions =
+      static_cast<const std::vector<std::string>*>(context);
+  std::size_t count = extensions->size();
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    std::string type = MimeType::GetType((*extensions)[i % count]);
+    bench::DoNotOptimize(type.data());
+  }
+}
+
+ResponseContext* MakeResponseContext(std::size_t body_size) {
+  ResponseContext* ctx = new ResponseContext();
+  ctx->response.SetStatus(200, "OK");
+  ctx->response.SetHeader("Content-Type", "text/html");
+  ctx->response.SetHeader("Connection", "keep-alive");
+  ctx->response.SetHeader("Server", "johnx/1.0.0");
+  ctx->response.SetHeader("Date", "Sat, 19 Apr 2025 10:00:00 GMT");
+  ctx->response.SetBody(std::string(body_size, 'x'));
+  return ctx;
+}
+
+}  // namespace
+
+namespace bench {
+
+void RegisterResponseCases() {
+  Register("response/to_string/0B", ResponseToString, MakeResponseContext(0));
+  Register("response/to_string/1KB", ResponseToString, MakeResponseContext(1024));
+  Register("response/to_string/64KB", ResponseToString, MakeResponseContext(65536));
+  Register("response/append_head", ResponseAppendHead, MakeResponseContext(1024));
+  Register("response/cgi_body_slice/256KB", ChainSliceBody, MakeCgiOutput(256 * 1024));
+
+  static std::vector<std::string> extensions;
+  const char* names[] = {"html", "css", "js", "png", "jpg", "json", "unknown", "JPG"};
+  for (std::size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    extensions.push_back(names[i]);
+  }
+  Register("mime/get_type", GetMimeType, &extensions);
+}
+
+}  // namespace bench
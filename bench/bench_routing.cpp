@@ -0,0 +1,108 @@
+#include "bench.h"
+
+#include <sstream>
+
+#include "../inc/Config/http_config.h"
+#include "../inc/Util/config_utils.h"
+
+namespace {
+
+struct LocationContext {
+  HttpConfig* config;
+  std::vector<HttpRequest> requests;
+};
+
+struct ServerContext {
+  HttpConfig* config;
+  std::vector<HttpRequest> requests;
+};
+
+std::string Number(int value) {
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+HttpConfig* BuildConfig(int server_count, int ports, int location_count) {
+  HttpConfig* config = new HttpConfig();
+  for (int s = 0; s < server_count; ++s) {
+    ServerConfig* server = new ServerConfig(config);
+    server->AddListenDirective("0.0.0.0", 8000 + s % ports);
+    server->AddServerName("site" + Number(s) + ".example.com");
+    server->AddServerName("www.site" + Number(s) + ".example.com");
+    for (int l = 0; l < location_count; ++l) {
+      LocationConfig* location = new LocationConfig(server);
+      location->SetPath(l == 0 ? "/" : "/section" + Number(l) + "/page");
+      server->AddLocation(location);
+    }
+    config->AddServer(server);
+  }
+  return config;
+}
+
+HttpRequest MakeRequest(const std::string& host, int port, const std::string& path) {
+  HttpRequest request;
+  request.SetMethod("GET");
+  request.SetPath(path);
+  request.SetHeader("host", host);
+  request.SetPort(port);
+  return request;
+}
+
+void FindLocation(void* context, unsigned long iterations) {
+  LocationContext* ctx = static_cast<LocationContext*>(context);
+  const ServerConfig* server = ctx->config->GetServers()[0];
+  std::size_t count = ctx->requests.size();
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    bench::DoNotOptimize(FindMatchingLocation(ctx->requests[i % count], server));
+  }
+}
+
+void FindServer(void* context, unsigned long iterations) {
+  ServerContext* ctx = static_cast<ServerContext*>(context);
+  std::size_t count = ctx->requests.size();
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    bench::DoNotOptimize(FindMatchingServerConfig(ctx->requests[i % count], ctx->config));
+  }
+}
+
+void RegisterLocationCase(int location_count) {
+  LocationContext* ctx = new LocationContext();
+  ctx->config = BuildConfig(1, 1, location_count);
+  for (int i = 0; i < 16; ++i) {
+    int target = (i * 7919) % location_count;
+    std::string path = "/section" + Number(target) + "/page/asset" + Number(i) + ".js";
+    ctx->requests.push_back(MakeRequest("site0.example.com", 8000, path));
+  }
+  ctx->requests.push_back(MakeRequest("site0.example.com", 8000, "/unmatched/path"));
+  bench::Register("routing/find_location/" + Number(location_count), FindLocation, ctx);
+}
+
+void RegisterServerCase(int server_count) {
+  ServerContext* ctx = new ServerContext();
+  ctx->config = BuildConfig(server_count, 4, 2);
+  for (int i = 0; i < 16; ++i) {
+    int target = (i * 7919) % server_count;
+    ctx->requests.push_back(MakeRequest("www.site" + Number(target) + ".example.com",
+                                        8000 + target % 4, "/"));
+  }
+  ctx->requests.push_back(MakeRequest("unknown.example.org", 8001, "/"));
+  bench::Register("routing/find_server/" + Number(server_count), FindServer, ctx);
+}
+
+}  // namespace
+
+namespace bench {
+
+void RegisterRoutingCases() {
+  RegisterLocationCase(8);
+  RegisterLocationCase(100);
+  RegisterLocationCase(1000);
+  RegisterServerCase(8);
+  RegisterServerCase(100);
+  RegisterServerCase(1000);
+}
+
+}  // namespace bench
@@ -0,0 +1,45 @@
+#include "bench.h"
+
+#include "../inc/Util/parsing_utils.h"
+
+namespace {
+
+void UrlDecode(void* context, unsigned long iterations) {
+  const std::string* input = static_cast<const std::string*>(context);
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    std::string decoded = parsing_utils::UrlDecode(*input);
+    bench::DoNotOptimize(decoded.data());
+  }
+}
+
+void NormalizePath(void* context, unsigned long iterations) {
+  const std::string* input = static_cast<const std::string*>(context);
+  std::string normalized;
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    parsing_utils::NormalizePath(*input, true, normalized);
+    bench::DoNotOptimize(normalized.data());
+  }
+}
+
+std::string* Repeat(const std::string& unit, int count) {
+  std::string* result = new std::string();
+  for (int i = 0; i < count; ++i) {
+    *result += unit;
+  }
+  return result;
+}
+
+}  // namespace
+
+namespace bench {
+
+void RegisterUtilCases() {
+  Register("util/url_decode/plain", UrlDecode, Repeat("abcdefgh", 16));
+  Register("util/url_decode/escaped", UrlDecode, Repeat("%E3%81%82+", 32));
+  Register("util/normalize_path/deep", NormalizePath, Repeat("/dir//./sub", 32));
+  Register("util/normalize_path/escaped", NormalizePath, Repeat("/%E3%81%82%2e/..", 32));
+}
+
+}  // namespace bench
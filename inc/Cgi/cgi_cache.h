@@ -0,0 +1,83 @@
+#ifndef WEBSERV_INCLUDES_CGI_CACHE_H_
+#define WEBSERV_INCLUDES_CGI_CACHE_H_
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../Util/buffer_chain.h"
+
+class HttpRequest;
+class LocationConfig;
+
+struct CgiCacheEntry {
+  int status;
+  std::string reason;
+  std::vector<std::pair<std::string, std::string> > headers;
+  BufferChain body;
+  std::time_t stored;
+  std::time_t expires;
+  std::time_t stale_until;
+  bool refreshing;
+};
+
+// Complete CGI responses keyed by (location, request key) for locations with
+// a cgi_cache, each location within its own max_size. An entry is fresh until its TTL runs out and may then be
+// served stale while a single refresh of it runs. With cgi_cache_lock, a
+// miss for a key that is already being fetched waits for that fetch
+// instead of starting its own.
+class CgiCache {
+ public:
+  static CgiCache& Instance();
+
+  const CgiCacheEntry* Find(const LocationConfig* location, const std::string& key,
+                            std::time_t now, bool* stale);
+  bool BeginRefresh(const LocationConfig* location, const std::string& key);
+  void EndRefresh(const LocationConfig* location, const std::string& key);
+  bool Store(const LocationConfig* location, const std::string& key,
+             const BufferChain& output, std::time_t now);
+  void Clear();
+
+  bool Lock(const LocationConfig* location, const std::string& key, int client_fd);
+  std::vector<int> Unlock(const LocationConfig* location, const std::string& key);
+  void CancelWait(const LocationConfig* location, const std::string& key, int client_fd);
+
+  static bool Cacheable(const HttpRequest& request);
+  static std::string MakeKey(const HttpRequest& request);
+
+ private:
+  typedef std::pair<const LocationConfig*, std::string> Key;
+
+  struct Node {
+    CgiCacheEntry entry;
+    std::size_t size;
+    std::list<Key>::iterator lru;
+  };
+
+  // Each location's cache has its own LRU order and max_size budget.
+  struct Zone {
+    Zone() : used_bytes(0) {}
+
+    std::list<Key> lru;
+    std::size_t used_bytes;
+  };
+
+  CgiCache();
+  ~CgiCache();
+  CgiCache(const CgiCache&);
+  CgiCache& operator=(const CgiCache&);
+
+  static bool ParseOutput(const BufferChain& output, CgiCacheEntry* entry);
+  static bool Lifetime(const CgiCacheEntry& entry, const LocationConfig* location,
+                       std::time_t now, std::time_t* ttl, std::time_t* stale);
+  void Erase(std::map<Key, Node>::iterator it);
+
+  std::map<Key, Node> entries_;
+  std::map<const LocationConfig*, Zone> zones_;
+  std::map<Key, std::vector<int> > locks_;
+};
+
+#endif
@@ -3,12 +3,40 @@
 
 #include <sys/wait.h>
 #include <unistd.h>
+#include <set>
 
 #include "../Web/client_connection.h"
 #include "../Web/event.h"
 #include "../Util/SocketFd.h"
 
 class ClientConnection;
+class CgiHandler;
+
+// Watches the script's stdin pipe for room and hands it back to its
+// handler, which keeps writing the request body from where it left off.
+class CgiInputWriter : public Event {
+public:
+    explicit CgiInputWriter(CgiHandler* handler);
+
+    void OnEvent(uint32_t events);
+    int getFd() const;
+
+private:
+    CgiHandler* handler_;
+};
+
+// Watches a pidfd for the script's exit, so the child is reaped as soon as
+// it exits rather than by polling waitpid.
+class CgiExitWatcher : public Event {
+public:
+    explicit CgiExitWatcher(CgiHandler* handler);
+
+    void OnEvent(uint32_t events);
+    int getFd() const;
+
+private:
+    CgiHandler* handler_;
+};
 
 enum CgiState {
     CGI_IDLE,
@@ -20,6 +48,9 @@ enum CgiState {
 };
 
 class CgiHandler : public Event {
+public:
+    typedef std::map<std::string, std::string> EnvMap;
+
 private:
     SocketFd inputPipeRead_;
     SocketFd inputPipeWrite_;
@@ -27,31 +58,50 @@ private:
     SocketFd outputPipeWrite_;
     SocketFd errorPipeRead_;
     SocketFd errorPipeWrite_;
+    SocketFd childPidFd_;
     pid_t childPid;
     int exitStatus;
-    std::map<std::string, std::string> envVars;
+    EnvMap envVars;
 
     std::string scriptPath;
     std::string queryString;
     std::string method;
     std::string requestBody;
+    size_t bodyWritten_;
+    CgiInputWriter inputWriter_;
+    bool inputRegistered_;
+    CgiExitWatcher exitWatcher_;
+    bool exitRegistered_;
     bool isCompleted;
     bool isRegistered;
     HttpResponse* response;
     int clientFd;
     std::string executor;
     pid_t pid;
-    std::string outputContent;
+    BufferChain outputContent;
     std::string errorContent;
     time_t startTime;
     time_t timeout;
     CgiState state_;
+    const LocationConfig* poolLocation_;
+    size_t headerScan_;
+    bool streaming_;
+    bool paused_;
+    const LocationConfig* cacheLocation_;
+    std::string cacheKey_;
+    BufferChain cacheOutput_;
+    bool cacheRefresh_;
+    bool cacheLocked_;
+    const LocationConfig* slotLocation_;
+
+    static const size_t kReadBudget = 256 * 1024;
+    static std::vector<pid_t> orphans_;
+    static std::set<CgiHandler*> unattended_;
 
     void createPipes();
     void cleanupPipes();
     void setupEnvironment(const ServerConfig &server, const HttpRequest &request, const std::string &scriptPath);
     bool terminateChildProcess(pid_t pid);
-    void setupChildProcess();
     char** prepareEnvironment();
     bool setupParentProcess();
     bool writeRequestBody();
@@ -60,23 +110,27 @@ private:
     void ReadOutputPipes();
     void ReadFromOutputPipe();
     void ReadFromErrorPipe();
+    void deliverOutput(const char* data, size_t length);
+    void pauseOutput();
     void CheckChildProcessStatus();
+    void watchChild();
+    void stopWatchingChild();
     void ProcessChildExitStatus(int status);
 
-    void PrepareResponseBody(std::string& responseBody, bool& hasError);
+    void PrepareResponseBody(BufferChain& responseBody, bool& hasError);
     void HandleTimeoutResponse(bool& hasError);
     void HandleErrorResponse(bool& hasError);
     void HandleEmptyOutputResponse(bool& hasError);
-    void HandleClientResponse(ClientConnection* client, const std::string& responseBody, bool hasError);
+    void HandleClientResponse(ClientConnection* client, const BufferChain& responseBody, bool hasError);
     void UnregisterAndCleanup();
 
-    void SetupBasicEnvironment(const HttpRequest &request, const std::string &scriptPath);
-    void SetupServerVariables(const ServerConfig &server);
-    void SetupRequestVariables(const HttpRequest &request);
-    void SetupContentVariables(const HttpRequest &request);
+    static void SetupBasicEnvironment(EnvMap &env, const HttpRequest &request, const std::string &scriptPath);
+    static void SetupServerVariables(EnvMap &env, const ServerConfig &server);
+    static void SetupRequestVariables(EnvMap &env, const HttpRequest &request);
+    static void SetupContentVariables(EnvMap &env, const HttpRequest &request);
 
-    bool WriteChunk(size_t& total, size_t& left);
-    void HandleWriteFailure();
+    void writeAvailableInput();
+    void finishInput();
 
 public:
     CgiHandler();
@@ -84,6 +138,10 @@ public:
 
     void executeCgi(const ServerConfig &server, const HttpRequest &request,
                     const std::string &scriptPath);
+    static pid_t SpawnScript(const std::string &executor, const std::string &scriptPath,
+                             char **env, const int fds[3]);
+    static EnvMap BuildEnvironment(const ServerConfig &server, const HttpRequest &request,
+                                   const std::string &scriptPath);
     bool isComplete() const;
     int getExitStatus() const;
 
@@ -115,6 +173,31 @@ public:
 
     CgiState getState() const;
     void setState(CgiState s);
+
+    void resumeOutput();
+    void onInputWritable();
+    int getInputFd() const;
+    void onChildExited();
+    int getPidFd() const;
+
+    void setPool(const LocationConfig* location);
+    void setCache(const LocationConfig* location, const std::string& key, bool refresh);
+    void holdCacheLock();
+    void finishCaching();
+    void holdSlot(const LocationConfig* location);
+    void releaseSlot();
+    void detachClient();
+    void orphanChild();
+    static void reapOrphans();
+    void watchUnattended();
+    static void expireUnattended();
+    const std::string& getScriptPath() const;
+    const EnvMap& getEnvironment() const;
+    void getChildFds(int* fds) const;
+    void onPoolDispatched();
+    void onPoolStarted(pid_t pid);
+    void onPoolExited(int status);
+    void onPoolFailed();
 };
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef WEBSERV_INCLUDES_CGI_LIMITER_H_
+#define WEBSERV_INCLUDES_CGI_LIMITER_H_
+
+#include <deque>
+#include <map>
+
+class LocationConfig;
+
+// Caps how many scripts a location with cgi_max_concurrency runs at once.
+// Requests over the cap wait as parked connections in a FIFO of up to
+// cgi_queue_size entries, and a slot that frees up goes to the oldest.
+class CgiLimiter {
+ public:
+  enum Admission { ADMITTED, QUEUED, REFUSED };
+
+  static CgiLimiter& Instance();
+
+  Admission Acquire(const LocationConfig* location, int client_fd);
+  void Release(const LocationConfig* location);
+  void CancelWait(const LocationConfig* location, int client_fd);
+
+ private:
+  struct Slots {
+    Slots() : running(0) {}
+
+    std::size_t running;
+    std::deque<int> waiting;
+  };
+
+  CgiLimiter();
+  ~CgiLimiter();
+  CgiLimiter(const CgiLimiter&);
+  CgiLimiter& operator=(const CgiLimiter&);
+
+  std::map<const LocationConfig*, Slots> slots_;
+};
+
+#endif
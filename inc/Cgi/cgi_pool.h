@@ -0,0 +1,83 @@
+#ifndef CGI_POOL_H
+#define CGI_POOL_H
+
+#include <sys/types.h>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../Config/http_config.h"
+#include "../Config/location_config.h"
+#include "../Web/event.h"
+
+class CgiHandler;
+
+// Helper process forked from the server before it starts serving. It takes
+// one script at a time over a socketpair (the script's pipe ends travel as
+// SCM_RIGHTS), forks and execs it from its own small image, and reports the
+// script's pid and exit status back.
+class CgiWorker : public Event {
+ public:
+  explicit CgiWorker(const LocationConfig* location);
+  ~CgiWorker();
+
+  void OnEvent(uint32_t events);
+  int getFd() const;
+
+  bool Spawn();
+  bool Run(CgiHandler* handler);
+  void Detach(CgiHandler* handler);
+  bool Busy() const;
+  void Tick(std::time_t now);
+
+ private:
+  void Close();
+  void Finish();
+  static void Serve(int socket);
+
+  const LocationConfig* location_;
+  int fd_;
+  pid_t pid_;
+  CgiHandler* handler_;
+  bool busy_;
+  pid_t script_pid_;
+  std::time_t kill_at_;
+  std::string input_;
+
+  CgiWorker(const CgiWorker&);
+  CgiWorker& operator=(const CgiWorker&);
+};
+
+// Workers and waiting requests for every location with a cgi_pool. A
+// request that finds all workers busy waits in its location's queue, and is
+// refused once the queue is at its configured limit.
+class CgiPool {
+ public:
+  static CgiPool& Instance();
+
+  void Init(const HttpConfig& config);
+  bool Submit(const LocationConfig* location, CgiHandler* handler);
+  void Cancel(CgiHandler* handler);
+  void OnWorkerIdle(CgiWorker* worker, const LocationConfig* location);
+  void Tick();
+
+ private:
+  struct Pool {
+    std::vector<CgiWorker*> workers;
+    std::deque<CgiHandler*> queue;
+  };
+
+  CgiPool();
+  ~CgiPool();
+  CgiPool(const CgiPool&);
+  CgiPool& operator=(const CgiPool&);
+
+  Pool& FindPool(const LocationConfig* location);
+  bool Dispatch(CgiWorker* worker, CgiHandler* handler);
+
+  std::map<const LocationConfig*, Pool> pools_;
+};
+
+#endif
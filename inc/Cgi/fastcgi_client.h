@@ -0,0 +1,104 @@
+#ifndef FASTCGI_CLIENT_H
+#define FASTCGI_CLIENT_H
+
+#include <sys/socket.h>
+#include <stdint.h>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../Util/buffer_chain.h"
+#include "../Web/event.h"
+
+class ClientConnection;
+
+// Non-blocking connection to a FastCGI application server. It carries one
+// request at a time and is opened with FCGI_KEEP_CONN, so after the
+// END_REQUEST record it goes back to its upstream's idle pool.
+class FastCgiConnection : public Event {
+ public:
+  enum State { CONNECTING, WRITING, READING, IDLE, BROKEN };
+
+  FastCgiConnection(const std::string& upstream, int fd, State state);
+  ~FastCgiConnection();
+
+  void OnEvent(uint32_t events);
+  int getFd() const;
+
+ private:
+  friend class FastCgiClient;
+
+  void Begin(const std::string& request, ClientConnection* client,
+             time_t deadline_ms, bool reused);
+  bool FinishConnect();
+  bool Flush();
+  void Read();
+  bool ParseRecords(bool closed);
+  void Fail(int status);
+  void Finish(int status, bool keep);
+  void Close();
+
+  std::string upstream_;
+  int fd_;
+  State state_;
+  std::string request_;
+  std::size_t written_;
+  std::string input_;
+  BufferChain stdout_;
+  ClientConnection* client_;
+  time_t deadline_ms_;
+  bool reused_;
+  bool received_;
+
+  FastCgiConnection(const FastCgiConnection&);
+  FastCgiConnection& operator=(const FastCgiConnection&);
+};
+
+// Keeps a pool of idle connections per fastcgi_pass address and hands
+// requests to them. Request timeouts and deferred deletion of closed
+// connections run from the event loop through Tick.
+class FastCgiClient {
+ public:
+  static FastCgiClient& Instance();
+
+  FastCgiConnection* Start(const std::string& upstream,
+                           const std::map<std::string, std::string>& params,
+                           const std::string& body, ClientConnection* client,
+                           time_t timeout_ms);
+  void Cancel(FastCgiConnection* conn);
+  void Tick();
+
+  static std::string EncodeRequest(const std::map<std::string, std::string>& params,
+                                   const std::string& body);
+
+ private:
+  friend class FastCgiConnection;
+
+  struct Upstream {
+    sockaddr_storage address;
+    socklen_t address_length;
+    std::vector<FastCgiConnection*> idle;
+  };
+
+  static const std::size_t kMaxIdlePerUpstream = 16;
+
+  FastCgiClient();
+  ~FastCgiClient();
+  FastCgiClient(const FastCgiClient&);
+  FastCgiClient& operator=(const FastCgiClient&);
+
+  Upstream* FindUpstream(const std::string& address);
+  FastCgiConnection* Connect(const std::string& address, const Upstream& upstream);
+  bool Retry(FastCgiConnection* conn);
+  void Release(FastCgiConnection* conn);
+  void Retire(FastCgiConnection* conn);
+  static time_t NowMs();
+
+  std::map<std::string, Upstream> upstreams_;
+  std::set<FastCgiConnection*> active_;
+  std::vector<FastCgiConnection*> retired_;
+};
+
+#endif
@@ -4,6 +4,9 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <ctime>
+
+#include "mime_type_table.h"
 
 class BaseConfig
 {
@@ -14,7 +17,23 @@ protected:
   std::map<int, std::string> error_pages_;
   bool autoindex_;
   bool autoindex_set_;
+  std::string autoindex_format_;
+  std::size_t autoindex_page_size_;
   std::vector<std::string> index_files_;
+  std::size_t open_file_cache_max_;
+  time_t open_file_cache_inactive_;
+  time_t open_file_cache_valid_;
+  bool open_file_cache_errors_;
+  std::size_t static_cache_max_size_;
+  std::size_t static_cache_max_file_;
+  bool gzip_;
+  std::vector<std::string> gzip_types_;
+  std::size_t gzip_min_length_;
+  bool gzip_static_;
+  std::size_t limit_rate_;
+  std::size_t limit_rate_after_;
+  MimeTypeTable types_;
+  bool types_set_;
 
 public:
   BaseConfig();
@@ -31,9 +50,38 @@ public:
   void SetAutoindex(bool autoindex);
   bool GetAutoindex() const;
   bool IsAutoindexSet() const;
+  void SetAutoindexFormat(const std::string &format);
+  const std::string &GetAutoindexFormat() const;
+  void SetAutoindexPageSize(std::size_t page_size);
+  std::size_t GetAutoindexPageSize() const;
   void AddIndexFile(const std::string &index_file);
   const std::vector<std::string> &GetIndexFiles() const;
   void ClearIndexFiles();
+  void SetOpenFileCache(std::size_t max, time_t inactive);
+  std::size_t GetOpenFileCacheMax() const;
+  time_t GetOpenFileCacheInactive() const;
+  void SetOpenFileCacheValid(time_t valid);
+  time_t GetOpenFileCacheValid() const;
+  void SetOpenFileCacheErrors(bool errors);
+  bool GetOpenFileCacheErrors() const;
+  void SetStaticCache(std::size_t max_size, std::size_t max_file);
+  std::size_t GetStaticCacheMaxSize() const;
+  std::size_t GetStaticCacheMaxFile() const;
+  void SetGzip(bool gzip);
+  bool GetGzip() const;
+  void SetGzipTypes(const std::vector<std::string> &types);
+  const std::vector<std::string> &GetGzipTypes() const;
+  void SetGzipMinLength(std::size_t length);
+  std::size_t GetGzipMinLength() const;
+  void SetGzipStatic(bool gzip_static);
+  bool GetGzipStatic() const;
+  void SetLimitRate(std::size_t rate);
+  std::size_t GetLimitRate() const;
+  void SetLimitRateAfter(std::size_t after);
+  std::size_t GetLimitRateAfter() const;
+  void DefineTypes();
+  void AddType(const std::string &type, const std::string &extension);
+  const MimeTypeTable &GetTypes() const;
 };
 
 #endif
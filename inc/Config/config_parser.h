@@ -3,8 +3,11 @@
 
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <cctype>
 #include <limits>
 #include <fstream>
+#include <sstream>
 
 #include "../Util/parsing_utils.h"
 #include "location_config.h"
@@ -21,7 +24,7 @@ public:
   HttpConfig* Parse(const std::string &filename);
 
 private:
-  std::ifstream _input;
+  std::istringstream _input;
   std::string _current_line;
   std::string _directive_line;
 
@@ -30,6 +33,11 @@ private:
   void JoinMultiLineDirective();
 
   void OpenConfigFile(const std::string &filename);
+  void ReadConfigFile(const std::string &filename, int depth, std::string *content);
+  std::string ResolveIncludePath(const std::string &including_file, const std::string &path);
+  bool IsTypesBlock() const;
+  void ParseTypesBlock(BaseConfig *config);
+  void AddTypesEntry(const std::string &entry, BaseConfig *config);
   void FindAndParseHttpBlock(HttpConfig* http_config);
   void CheckAndCreateDefaultServer(HttpConfig* http_config);
 
@@ -53,6 +61,18 @@ private:
   void ParseErrorPageDirective(const std::string &value, BaseConfig *config);
   void ParseAutoIndexDirective(const std::string &value, BaseConfig *config);
   void ParseIndexDirective(const std::string &value, BaseConfig *config);
+  void ParseAutoIndexFormatDirective(const std::string &value, BaseConfig *config);
+  void ParseAutoIndexPageSizeDirective(const std::string &value, BaseConfig *config);
+  void ParseOpenFileCacheDirective(const std::string &value, BaseConfig *config);
+  void ParseOpenFileCacheValidDirective(const std::string &value, BaseConfig *config);
+  void ParseOpenFileCacheErrorsDirective(const std::string &value, BaseConfig *config);
+  void ParseStaticCacheDirective(const std::string &value, BaseConfig *config);
+  off_t ParseSizeParameter(const std::string &directive, const std::string &token);
+  bool ParseFlagDirective(const std::string &directive, const std::string &value);
+  std::size_t ParseCountDirective(const std::string &directive, const std::string &value);
+  void ParseGzipTypesDirective(const std::string &value, BaseConfig *config);
+  void ParseGzipMinLengthDirective(const std::string &value, BaseConfig *config);
+  std::size_t ParseSingleSizeDirective(const std::string &directive, const std::string &value);
   void ParseKeepaliveTimeoutDirective(const std::string &value, BaseConfig *config);
   void ParseServerRedirectDirective(const std::string &value, BaseConfig *config);
   void ParseListenDirective(const std::string &value, ServerConfig *server);
@@ -60,6 +80,11 @@ private:
   void ParseLimitExceptDirective(const std::string &value, LocationConfig *location);
   void ParseLocationRedirectDirective(const std::string &value, LocationConfig *location);
   void ParseCgiPassDirective(const std::string &value, LocationConfig *location);
+  void ParseFastCgiPassDirective(const std::string &value, LocationConfig *location);
+  void ParseCgiPoolDirective(const std::string &value, LocationConfig *location);
+  void ParseCgiCacheDirective(const std::string &value, LocationConfig *location);
+  void ParseCgiCacheLockTimeoutDirective(const std::string &value, LocationConfig *location);
+  void ParseCgiQueueTimeoutDirective(const std::string &value, LocationConfig *location);
   void ParseCgiReadTimeoutDirective(const std::string &value, LocationConfig *location);
 
   Directive ExtractDirective();
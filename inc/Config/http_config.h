@@ -2,6 +2,7 @@
 #define HTTP_CONFIG_HPP
 
 #include "server_config.h"
+#include "virtual_host_index.h"
 
 struct ListenDirective;
 class ServerConfig;
@@ -9,6 +10,7 @@ class ServerConfig;
 class HttpConfig : public BaseConfig {
 private:
   std::vector<ServerConfig*> servers_;
+  VirtualHostIndex vhost_index_;
   time_t keepalive_timeout_;
   bool keepalive_timeout_set_;
 
@@ -26,6 +28,7 @@ public:
   HttpConfig& operator=(const HttpConfig& other);
   const std::vector<ServerConfig*>& GetServers() const;
   void AddServer(ServerConfig* server);
+  ServerConfig* FindServer(const char* host, std::size_t length, int port) const;
 
   time_t GetKeepaliveTimeout() const;
   void SetKeepaliveTimeout(time_t timeout);
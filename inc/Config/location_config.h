@@ -14,10 +14,22 @@ private:
   std::pair<std::string, int> redirect_;
   std::string script_filename_;
   std::map<std::string, std::string> cgi_executors_;
+  std::string fastcgi_pass_;
+  std::size_t cgi_pool_size_;
+  std::size_t cgi_pool_queue_;
+  std::size_t cgi_cache_max_size_;
+  time_t cgi_cache_valid_;
+  time_t cgi_cache_stale_;
+  bool cgi_cache_lock_;
+  time_t cgi_cache_lock_timeout_;
+  std::size_t cgi_max_concurrency_;
+  std::size_t cgi_queue_size_;
+  time_t cgi_queue_timeout_;
   int cgi_read_timeout_;
   std::string upload_path_;
   time_t keepalive_timeout_;
   bool keepalive_timeout_set_;
+  bool internal_;
 
 public:
   LocationConfig();
@@ -40,6 +52,29 @@ public:
   const std::map<std::string, std::string>& GetCgiExecutors() const;
   std::string GetCgiExecutor(const std::string& extension) const;
 
+  void SetFastCgiPass(const std::string& address);
+  const std::string& GetFastCgiPass() const;
+
+  void SetCgiPool(std::size_t size, std::size_t queue);
+  std::size_t GetCgiPoolSize() const;
+  std::size_t GetCgiPoolQueue() const;
+
+  void SetCgiCache(std::size_t max_size, time_t valid, time_t stale);
+  std::size_t GetCgiCacheMaxSize() const;
+  time_t GetCgiCacheValid() const;
+  time_t GetCgiCacheStale() const;
+  void SetCgiCacheLock(bool lock);
+  bool GetCgiCacheLock() const;
+  void SetCgiCacheLockTimeout(time_t timeout);
+  time_t GetCgiCacheLockTimeout() const;
+
+  void SetCgiMaxConcurrency(std::size_t max);
+  std::size_t GetCgiMaxConcurrency() const;
+  void SetCgiQueueSize(std::size_t size);
+  std::size_t GetCgiQueueSize() const;
+  void SetCgiQueueTimeout(time_t timeout);
+  time_t GetCgiQueueTimeout() const;
+
   void SetCgiReadTimeout(int timeout);
   int GetCgiReadTimeout() const;
   void SetUploadPath(const std::string& path);
@@ -48,6 +83,9 @@ public:
   void SetKeepaliveTimeout(time_t timeout);
   time_t GetKeepaliveTimeout() const;
   bool IsKeepaliveTimeoutSet() const;
+
+  void SetInternal(bool internal);
+  bool IsInternal() const;
 };
 
 #endif
@@ -0,0 +1,36 @@
+#ifndef LOCATION_TRIE_HPP
+#define LOCATION_TRIE_HPP
+
+#include <map>
+#include <string>
+
+class LocationConfig;
+
+// Radix trie over location prefixes. Lookup walks the request path once and
+// returns the location with the longest matching prefix.
+class LocationTrie {
+ private:
+  struct Node {
+    std::string label;
+    const LocationConfig* location;
+    std::map<char, Node*> children;
+
+    Node() : location(NULL) {}
+  };
+
+  Node* root_;
+
+  static Node* CopyNode(const Node* node);
+  static void DeleteNode(Node* node);
+
+ public:
+  LocationTrie();
+  LocationTrie(const LocationTrie& other);
+  ~LocationTrie();
+  LocationTrie& operator=(const LocationTrie& other);
+
+  void Insert(const std::string& prefix, const LocationConfig* location);
+  const LocationConfig* FindLongestPrefix(const std::string& path) const;
+};
+
+#endif
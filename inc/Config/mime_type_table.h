@@ -0,0 +1,45 @@
+#ifndef MIME_TYPE_TABLE_H
+#define MIME_TYPE_TABLE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Extension to MIME type map filled from types { } blocks. Lookups are
+// case-insensitive and allocation-free (open addressing over a lowercased
+// FNV hash). Copies share one table, so a large mime.types loaded in the
+// http block is not duplicated into every server and location.
+class MimeTypeTable {
+ public:
+  MimeTypeTable();
+  MimeTypeTable(const MimeTypeTable& other);
+  ~MimeTypeTable();
+  MimeTypeTable& operator=(const MimeTypeTable& other);
+
+  void Reset();
+  void Add(const std::string& extension, const std::string& type);
+  const char* Find(const char* extension, std::size_t length) const;
+  bool Defined() const;
+  bool Empty() const;
+
+ private:
+  struct Entry {
+    std::string extension;
+    std::string type;
+  };
+
+  struct Block {
+    std::vector<Entry> slots;
+    std::size_t count;
+    std::size_t refs;
+  };
+
+  static std::size_t Hash(const char* extension, std::size_t length);
+  void Insert(const std::string& extension, const std::string& type);
+  void Grow();
+  void Release();
+
+  Block* block_;
+};
+
+#endif
@@ -7,6 +7,8 @@
 #include "base_config.h"
 #include "location_config.h"
 #include "http_config.h"
+#include "location_trie.h"
+#include "../Util/shared_buffer.h"
 
 class HttpConfig;
 class LocationConfig;
@@ -17,9 +19,16 @@ struct ListenDirective {
   ListenDirective(const std::string& h, int p) : host(h), port(p) {}
 };
 
+// Contents of an error_page file, read once when the server block is loaded.
+struct ErrorPageBody {
+  SharedBuffer body;
+  std::string content_type;
+};
+
 class ServerConfig : public BaseConfig {
  private:
   std::map<std::string, LocationConfig*> locations_;
+  LocationTrie location_trie_;
   std::vector<std::string> server_names_;
   bool is_default_;
   time_t keepalive_timeout_;
@@ -27,6 +36,7 @@ class ServerConfig : public BaseConfig {
   std::pair<std::string, int> redirect_;
   std::vector<ListenDirective> listen_directives_;
   HttpConfig* http_config_;
+  std::map<int, ErrorPageBody> error_page_bodies_;
 
  public:
   ServerConfig();
@@ -48,7 +58,10 @@ class ServerConfig : public BaseConfig {
   const std::vector<ListenDirective>& GetListenDirectives() const;
   const std::map<std::string, LocationConfig*>& GetLocations() const;
   void AddLocation(LocationConfig* location);
+  const LocationConfig* FindLocation(const std::string& path) const;
   const HttpConfig* GetHttpConfig() const;
+  void LoadErrorPages();
+  const ErrorPageBody* FindErrorPage(int code) const;
 };
 
 #endif
@@ -0,0 +1,72 @@
+#ifndef VIRTUAL_HOST_INDEX_HPP
+#define VIRTUAL_HOST_INDEX_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+class ServerConfig;
+
+// Server lookup table built at config load. Exact names live in a hash
+// table keyed by (port, lowercased name); "*.example.com" and ".example.com"
+// go into a suffix trie walked from the end of the host.
+class VirtualHostIndex {
+ private:
+  struct NameEntry {
+    int port;
+    std::string name;
+    ServerConfig* server;
+
+    NameEntry() : port(0), server(NULL) {}
+  };
+
+  struct SuffixNode {
+    std::map<char, SuffixNode*> children;
+    ServerConfig* subdomain;
+    ServerConfig* domain;
+
+    SuffixNode() : subdomain(NULL), domain(NULL) {}
+  };
+
+  struct PortEntry {
+    ServerConfig* default_server;
+    ServerConfig* first_server;
+    SuffixNode* wildcards;
+
+    PortEntry() : default_server(NULL), first_server(NULL), wildcards(NULL) {}
+  };
+
+  static const int kAnyPort = -1;
+
+  std::vector<NameEntry> names_;
+  std::size_t name_count_;
+  std::map<int, PortEntry> ports_;
+  SuffixNode* any_port_wildcards_;
+  ServerConfig* first_server_;
+
+  VirtualHostIndex(const VirtualHostIndex& other);
+  VirtualHostIndex& operator=(const VirtualHostIndex& other);
+
+  static std::size_t Hash(int port, const char* name, std::size_t length);
+  static void DeleteSuffixNode(SuffixNode* node);
+
+  void AddName(int port, const std::string& name, ServerConfig* server);
+  void InsertEntry(int port, const std::string& name, ServerConfig* server);
+  void Grow();
+  ServerConfig* FindName(int port, const char* host, std::size_t length) const;
+  static void AddWildcard(SuffixNode** root, const std::string& suffix,
+                          bool match_domain, ServerConfig* server);
+  static ServerConfig* FindWildcard(const SuffixNode* root,
+                                    const char* host, std::size_t length);
+
+ public:
+  VirtualHostIndex();
+  ~VirtualHostIndex();
+
+  void Add(ServerConfig* server);
+  void Clear();
+  ServerConfig* Find(const char* host, std::size_t length, int port) const;
+};
+
+#endif
@@ -109,6 +109,12 @@ class PreconditionFailedException : public HttpException {
   ~PreconditionFailedException() throw();
 };
 
+class RangeNotSatisfiableException : public HttpException {
+ public:
+  RangeNotSatisfiableException();
+  ~RangeNotSatisfiableException() throw();
+};
+
 class MisdirectedRequestException : public HttpException {
  public:
   MisdirectedRequestException();
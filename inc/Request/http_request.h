@@ -4,6 +4,8 @@
 #include "../Util/libft.h"
 #include "multipart_data.h"
 
+class LocationConfig;
+
 class HttpRequest {
  public:
   HttpRequest();
@@ -22,6 +24,7 @@ class HttpRequest {
   bool GetIsChunked() const;
   const std::map<std::string, std::string>& GetHeaders() const;
   int GetPort() const;
+  const LocationConfig* GetLocation() const;
 
   void SetMethod(const std::string& method);
   void SetPath(const std::string& path);
@@ -37,6 +40,9 @@ class HttpRequest {
   void SetHeader(const std::string& key, const std::string& value);
   void SetMultipartData(const MultipartData& data);
   void SetPort(int port);
+  void SetLocation(const LocationConfig* location);
+  void SetInternal(bool internal);
+  bool IsInternal() const;
 
   bool IsMultipart() const;
   void Reset();
@@ -55,6 +61,8 @@ class HttpRequest {
   std::string boundary_;
   bool is_chunked_;
   int port_;
+  const LocationConfig* location_;
+  bool internal_;
 };
 
 #endif
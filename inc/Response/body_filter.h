@@ -0,0 +1,133 @@
+#ifndef WEBSERV_INCLUDES_BODY_FILTER_H_
+#define WEBSERV_INCLUDES_BODY_FILTER_H_
+
+#include <sys/types.h>
+#include <ctime>
+#include <vector>
+
+#include "../Config/base_config.h"
+#include "../Web/output_queue.h"
+#include "http_response.h"
+
+// One stage of the response body pipeline. Segments pass through the chain
+// in order; Finish is called once after the last one.
+class BodyFilter {
+ public:
+  BodyFilter();
+  virtual ~BodyFilter();
+
+  void SetNext(BodyFilter* next);
+  virtual void Write(const BodySegment& segment) = 0;
+  virtual void Finish();
+  virtual bool Failed() const;
+
+ protected:
+  void Forward(const BodySegment& segment);
+  void Forward(const SharedBuffer& data);
+
+  BodyFilter* next_;
+
+ private:
+  BodyFilter(const BodyFilter&);
+  BodyFilter& operator=(const BodyFilter&);
+};
+
+// Passes only the bytes in [offset, offset + length) of the body.
+class RangeFilter : public BodyFilter {
+ public:
+  RangeFilter(off_t offset, off_t length);
+  void Write(const BodySegment& segment);
+
+ private:
+  off_t position_;
+  off_t start_;
+  off_t end_;
+};
+
+// Frames every segment as an HTTP/1.1 chunk and ends the body with the
+// last-chunk. File segments stay file segments between the size lines.
+class ChunkedFilter : public BodyFilter {
+ public:
+  void Write(const BodySegment& segment);
+  void Finish();
+};
+
+// Counts body bytes on their way to the socket. A body that ends short of
+// or past its declared length marks the pipeline failed so the connection
+// is closed instead of reused.
+class CountingFilter : public BodyFilter {
+ public:
+  explicit CountingFilter(off_t expected);
+  void Write(const BodySegment& segment);
+  void Finish();
+  bool Failed() const;
+  off_t Count() const;
+
+ private:
+  off_t expected_;
+  off_t count_;
+  bool failed_;
+};
+
+// Last stage: hands segments to the connection's output queue.
+class QueueFilter : public BodyFilter {
+ public:
+  explicit QueueFilter(OutputQueue* output);
+  void Write(const BodySegment& segment);
+
+ private:
+  OutputQueue* output_;
+};
+
+// Feeds a response body through its filters into an output queue. Bodies
+// that are re-encoded or rate limited are fed a slice at a time as the
+// queue drains, so they never have to be held in memory whole. A streamed
+// body stays open for Append until End, as its producer delivers it.
+class BodyPipeline {
+ public:
+  BodyPipeline();
+  ~BodyPipeline();
+
+  void Start(const HttpResponse& response, const BaseConfig* config,
+             OutputQueue* output, bool streaming = false);
+  void Append(const SharedBuffer& data);
+  void End();
+  void Pump();
+  void Reset();
+  bool Done() const;
+  bool Streaming() const;
+  bool Starved() const;
+  bool Throttled() const;
+  bool Failed() const;
+  off_t Buffered() const;
+  off_t BytesSent() const;
+
+ private:
+  static const off_t kSliceSize = 64 * 1024;
+  static const off_t kLowWatermark = 64 * 1024;
+
+  void AddFilter(BodyFilter* filter);
+  void AddSource(const BodySegment& segment);
+  void Feed(off_t limit);
+  off_t Allowance() const;
+  static time_t NowMs();
+
+  std::vector<BodySegment> source_;
+  std::size_t index_;
+  std::vector<BodyFilter*> filters_;
+  CountingFilter* counter_;
+  OutputQueue* output_;
+  bool sliced_;
+  bool done_;
+  bool streaming_;
+  off_t buffered_;
+  off_t rate_;
+  off_t rate_after_;
+  off_t fed_;
+  time_t started_ms_;
+
+  BodyPipeline(const BodyPipeline&);
+  BodyPipeline& operator=(const BodyPipeline&);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef WEBSERV_INCLUDES_DIRECTORY_LISTING_H_
+#define WEBSERV_INCLUDES_DIRECTORY_LISTING_H_
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../Util/shared_buffer.h"
+
+// Autoindex pages. Directory contents are read once and kept until the
+// directory's mtime changes; rendered pages are produced as fixed-size
+// shared chunks and kept with the contents they were built from.
+class DirectoryListing {
+ public:
+  enum Format { kHtml, kJson };
+
+  static DirectoryListing& Instance();
+
+  // Appends the chunks of the requested page (1-based) and returns the
+  // number of pages, or 0 when the page does not exist.
+  std::size_t Render(const std::string& path, const struct stat& st,
+                     const std::string& request_path, Format format,
+                     std::size_t page_size, std::size_t page,
+                     std::vector<SharedBuffer>* chunks);
+  void Clear();
+
+ private:
+  struct Entry {
+    std::string name;
+    bool is_directory;
+    off_t size;
+    std::time_t mtime;
+
+    bool operator<(const Entry& other) const { return name < other.name; }
+  };
+
+  struct Directory {
+    struct stat st;
+    std::vector<Entry> entries;
+    std::map<std::string, std::vector<SharedBuffer> > pages;
+    std::list<std::string>::iterator lru;
+  };
+
+  class ChunkWriter {
+   public:
+    explicit ChunkWriter(std::vector<SharedBuffer>* chunks);
+    void Append(const std::string& data);
+    void Append(const char* data, std::size_t length);
+    void AppendNumber(off_t value, std::size_t width = 0);
+    void Flush();
+
+   private:
+    std::vector<SharedBuffer>* chunks_;
+    std::string buffer_;
+  };
+
+  static const std::size_t kChunkSize = 16 * 1024;
+  static const std::size_t kMaxDirectories = 32;
+  static const std::size_t kMaxPagesPerDirectory = 32;
+
+  DirectoryListing();
+  ~DirectoryListing();
+  DirectoryListing(const DirectoryListing&);
+  DirectoryListing& operator=(const DirectoryListing&);
+
+  Directory& Load(const std::string& path, const struct stat& st);
+  static bool SameDirectory(const struct stat& a, const struct stat& b);
+  static void Scan(const std::string& path, std::vector<Entry>* entries);
+  static void RenderHtml(const Directory& directory, const std::string& request_path,
+                         std::size_t first, std::size_t last,
+                         std::size_t page, std::size_t page_count,
+                         ChunkWriter* writer);
+  static void RenderJson(const Directory& directory, std::size_t first,
+                         std::size_t last, ChunkWriter* writer);
+  static void AppendEscaped(const std::string& value, Format format,
+                            ChunkWriter* writer);
+
+  std::map<std::string, Directory> directories_;
+  std::list<std::string> lru_;
+};
+
+#endif
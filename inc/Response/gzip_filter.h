@@ -0,0 +1,60 @@
+#ifndef WEBSERV_INCLUDES_GZIP_FILTER_H_
+#define WEBSERV_INCLUDES_GZIP_FILTER_H_
+
+#include <string>
+#include <zlib.h>
+
+#include "../Config/location_config.h"
+#include "../Request/http_request.h"
+#include "body_filter.h"
+#include "http_response.h"
+
+// On-the-fly gzip for response bodies, driven by the gzip directives of the
+// location that served the request.
+class GzipFilter {
+ public:
+  static bool ClientAccepts(const HttpRequest& request);
+  static bool MatchesType(const BaseConfig& config, const std::string& content_type);
+  static void Apply(const LocationConfig* location, bool accepts_gzip,
+                    HttpResponse* response);
+  static void ApplyStream(const LocationConfig* location, bool accepts_gzip,
+                          HttpResponse* response);
+  static bool Compress(const std::string& input, std::string* output);
+
+ private:
+  static const off_t kStreamThreshold = 64 * 1024;
+
+  static bool Eligible(const LocationConfig* location, HttpResponse* response);
+  static void CompressWhileSending(HttpResponse* response);
+  static void MarkEncoded(HttpResponse* response);
+  static void AddVary(HttpResponse* response);
+  static std::string CollectBody(const HttpResponse& response);
+};
+
+// Streaming counterpart of Compress for the body pipeline: deflates segments
+// as they arrive and forwards the output in fixed-size buffers.
+class GzipBodyFilter : public BodyFilter {
+ public:
+  GzipBodyFilter();
+  ~GzipBodyFilter();
+
+  void Write(const BodySegment& segment);
+  void Finish();
+  bool Failed() const;
+
+ private:
+  static const std::size_t kOutputSize = 16 * 1024;
+  static const std::size_t kReadSize = 64 * 1024;
+
+  void Deflate(const char* data, std::size_t size, int flush);
+  void Emit();
+
+  z_stream stream_;
+  bool initialized_;
+  bool failed_;
+  std::string output_;
+  std::size_t used_;
+  std::string read_buffer_;
+};
+
+#endif
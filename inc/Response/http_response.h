@@ -1,10 +1,31 @@
 #ifndef WEBSERV_INCLUDES_HTTP_RESPONSE_H_
 #define WEBSERV_INCLUDES_HTTP_RESPONSE_H_
 
-#include <map>
+#include <sys/types.h>
+#include <vector>
 #include <cstring>
 
+#include "../Util/buffer_chain.h"
 #include "../Util/libft.h"
+#include "../Util/shared_buffer.h"
+#include "../Util/shared_fd.h"
+
+// Part of a response body sent after the in-memory body: either a byte
+// range of a shared buffer or, when file is valid, a byte range of an open
+// file.
+struct BodySegment {
+  SharedBuffer data;
+  SharedFd file;
+  off_t offset;
+  off_t length;
+};
+
+// A response header as it goes on the wire. Known names are stored in their
+// canonical spelling; anything else keeps the case it was set with.
+struct HeaderField {
+  std::string name;
+  std::string value;
+};
 
 class HttpResponse {
  public:
@@ -13,15 +34,30 @@ class HttpResponse {
 
   void SetStatus(int code, const std::string& message);
   void SetHeader(const std::string& key, const std::string& value);
+  void RemoveHeader(const std::string& key);
   void SetBody(const std::string& body);
+  void SetBody(const SharedBuffer& body);
+  void SetBody(const BufferChain& body);
+  void AppendBody(const SharedBuffer& data);
+  void AppendFile(const SharedFd& file, off_t offset, off_t length);
+  void SetBodyRange(off_t offset, off_t length);
+  void SetCompressBody(bool compress);
   std::string ToString() const;
+  std::string SerializeHead() const;
+  void AppendHead(std::string* out) const;
   void Clear();
 
   int GetStatusCode() const;
   const std::string& GetStatusMessage() const;
-  std::string GetHeader(const std::string& key) const;
-  const std::map<std::string, std::string>& GetHeaders() const;
-  std::string GetBody() const;
+  const std::string& GetHeader(const std::string& key) const;
+  std::size_t GetHeaderCount() const;
+  const HeaderField& GetHeaderField(std::size_t index) const;
+  const SharedBuffer& GetBodyBuffer() const;
+  const std::vector<BodySegment>& GetBodySegments() const;
+  off_t GetBodyLength() const;
+  bool HasBodyRange() const;
+  off_t GetBodyRangeOffset() const;
+  bool GetCompressBody() const;
 
   void SetClientFd(int fd);
   int GetClientFd() const;
@@ -34,11 +70,18 @@ class HttpResponse {
  private:
   int status_code_;
   std::string status_message_;
-  std::map<std::string, std::string> headers_;
-  std::string body_;
+  std::vector<HeaderField> headers_;
+  std::size_t header_count_;
+  SharedBuffer body_;
+  std::vector<BodySegment> segments_;
+  off_t range_offset_;
+  off_t range_length_;
+  bool compress_body_;
   int clientFd_;
   bool is_cgi_response_;
   bool is_cgi_processed_;
+
+  std::size_t FindHeader(const std::string& key) const;
 };
 
 #endif
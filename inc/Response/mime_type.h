@@ -1,15 +1,22 @@
 #ifndef WEBSERV_INCLUDES_MIME_TYPE_H_
 #define WEBSERV_INCLUDES_MIME_TYPE_H_
 
-#include <map>
+#include <cstddef>
 #include <string>
 
+#include "../Config/base_config.h"
+#include "../Config/mime_type_table.h"
+
+// Content types by file extension. A types { } block in the configuration
+// replaces the built-in table for that context, as in nginx.
 class MimeType {
  public:
-  static std::string GetType(const std::string& extension);
+  static const char* GetType(const std::string& extension);
+  static const char* GetType(const char* extension, std::size_t length);
+  static const char* ForPath(const BaseConfig& config, const std::string& path);
 
  private:
-  static std::map<std::string, std::string>& GetMimeTypes();
+  static const MimeTypeTable& BuiltinTypes();
 };
 
 #endif
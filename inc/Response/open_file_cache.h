@@ -0,0 +1,74 @@
+#ifndef WEBSERV_INCLUDES_OPEN_FILE_CACHE_H_
+#define WEBSERV_INCLUDES_OPEN_FILE_CACHE_H_
+
+#include <sys/stat.h>
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+
+#include "../Config/base_config.h"
+
+// Result of an open file cache lookup. When the cache is disabled for the
+// location the descriptor belongs to this object and is closed with it.
+struct OpenFileInfo {
+  int fd;
+  struct stat st;
+  int error;
+  bool readable;
+  bool owns_fd;
+
+  OpenFileInfo();
+  ~OpenFileInfo();
+
+ private:
+  OpenFileInfo(const OpenFileInfo&);
+  OpenFileInfo& operator=(const OpenFileInfo&);
+};
+
+// Process-wide cache of stat results, open descriptors and, with
+// open_file_cache_errors, failed lookups. Entries are revalidated once
+// open_file_cache_valid has elapsed and dropped when unused for longer than
+// the inactive period of the location that added them, or when the
+// location's max is exceeded.
+class OpenFileCache {
+ public:
+  static OpenFileCache& Instance();
+
+  bool Lookup(const std::string& path, const BaseConfig& config,
+              bool open_file, OpenFileInfo* info);
+  void Invalidate(const std::string& path);
+  void Clear();
+
+ private:
+  struct Entry {
+    int fd;
+    struct stat st;
+    int error;
+    bool readable;
+    time_t validated_ms;
+    time_t inactive_ms;
+    std::list<std::string>::iterator lru;
+    std::multimap<time_t, std::string>::iterator expiry;
+  };
+
+  OpenFileCache();
+  ~OpenFileCache();
+  OpenFileCache(const OpenFileCache&);
+  OpenFileCache& operator=(const OpenFileCache&);
+
+  static time_t NowMs();
+  static void Probe(const std::string& path, Entry* entry);
+  static bool SameFile(const struct stat& a, const struct stat& b);
+
+  void Revalidate(const std::string& path, Entry* entry);
+  void Expire(time_t now);
+  void Erase(std::map<std::string, Entry>::iterator it);
+  bool Fill(const Entry& entry, bool open_file, OpenFileInfo* info) const;
+
+  std::map<std::string, Entry> entries_;
+  std::list<std::string> lru_;
+  std::multimap<time_t, std::string> expiry_;
+};
+
+#endif
@@ -2,14 +2,20 @@
 #define RESPONSE_BUILDER_H_
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <iomanip>
+#include <limits>
 
 #include "../Config/server_config.h"
 #include "../Config/location_config.h"
 #include "../Request/http_request.h"
 #include "../Cgi/cgi_handler.h"
+#include "directory_listing.h"
+#include "gzip_filter.h"
 #include "mime_type.h"
+#include "open_file_cache.h"
+#include "static_cache.h"
 
 class ClientConnection;
 class CgiHandler;
@@ -24,6 +30,8 @@ class ResponseBuilder {
   void BuildHeaders(int status_code);
   void BuildBody(int status_code, const ServerConfig& config);
   void BuildDefaultErrorPage(int status_code);
+  static const SharedBuffer& DefaultErrorBody(int status_code,
+                                              const std::string& message);
 
   HttpResponse* GetResponse();
   void SetResponse(HttpResponse* response);
@@ -35,11 +43,6 @@ class ResponseBuilder {
   std::string getRedirectMessage(int code);
 
   void HandleDeleteError() const;
-  std::string GenerateDirectoryListing(const std::string& path,
-                                     const std::string& request_path) const;
-  std::string CreateDirectoryHeader(const std::string &request_path) const;
-  std::string CreateDirectoryEntry(const std::string &entry_name, const struct stat &file_stat) const;
-  void ReadDirectoryEntries(DIR *dir, const std::string &path, std::stringstream &listing) const;
   bool HandleRedirect(const HttpRequest& request,
                      HttpResponse* response,
                      const ServerConfig& config);
@@ -47,25 +50,40 @@ class ResponseBuilder {
                        HttpResponse* response,
                        const LocationConfig& location,
                        const std::string& scriptPath);
+  bool ServeFromCgiCache(const HttpRequest& request,
+                         HttpResponse* response,
+                         const LocationConfig& location,
+                         const std::string& executor,
+                         const std::string& scriptPath,
+                         const std::string& key);
+  void RefreshCgiCache(const HttpRequest& request,
+                       const LocationConfig& location,
+                       const std::string& executor,
+                       const std::string& scriptPath,
+                       const std::string& key);
+  void HandleFastCgiRequest(const HttpRequest& request,
+                           HttpResponse* response,
+                           const LocationConfig& location,
+                           const std::string& scriptPath);
   std::string GetCgiExecutor(const HttpRequest &request, const LocationConfig &location) const;
   void ValidateScriptPath(const std::string &scriptPath) const;
   ClientConnection* GetClientConnection(HttpResponse *response) const;
   void SetupCgiHandler(CgiHandler *cgi, HttpResponse *response, const std::string &executor,
                      int clientFd, const LocationConfig &location);
   void RegisterCgiHandler(CgiHandler *cgi) const;
+  bool FindInternalUri(const std::string& file, std::string* uri) const;
 
  private:
   void HandleHttpMethod(const HttpRequest& request);
   void ValidateHttpMethod(const std::string& method, const LocationConfig* location);
   bool IsMethodAccepted(const std::string& method,
                        const std::vector<std::string>& accepted_methods);
-  std::string ResolveRootPath(const std::string& location_root,
+  std::string ResolveRootPath(const LocationConfig* location,
                              const ServerConfig& config) const;
   std::string CombineRootPaths(const std::string& location_root,
                               const ServerConfig& config) const;
-  void ValidateResolvedPath(const std::string& resolved_path) const;
-  void NormalizePathSeparators(std::string& resolved_path) const;
-  void ValidateDirectoryAccess(const std::string& resolved_path) const;
+  void ValidateDirectoryAccess(const std::string& resolved_path,
+                               const LocationConfig* location) const;
   std::string ResolveFinalPath(const LocationConfig* location,
                               const HttpRequest& request,
                               const ServerConfig& config,
@@ -76,7 +94,9 @@ class ResponseBuilder {
                           const std::string& remaining_path) const;
   bool IsCgiPath(const HttpRequest& request,
                 const LocationConfig* location) const;
-  std::string ValidateAndCheckPath(const std::string& path, bool* is_directory) const;
+  std::string ValidateAndCheckPath(const std::string& path,
+                                   const LocationConfig* location,
+                                   bool* is_directory) const;
   void HandleGetRequest(const HttpRequest& request,
                        HttpResponse* response,
                        const ServerConfig& config);
@@ -86,10 +106,42 @@ class ResponseBuilder {
   bool TryFindIndexFile(const std::string& path,
                        const LocationConfig* location,
                        std::string* index_path);
-  void ServeDirectoryListing(const std::string& dir_path,
-                            const std::string& request_path,
+  void ServeDirectoryListing(const HttpRequest& request,
+                             const std::string& dir_path,
+                             const LocationConfig* location,
+                             HttpResponse* response) const;
+  std::size_t ParsePageParameter(const std::string& query) const;
+  bool ServeFromStaticCache(const HttpRequest& request,
+                            const LocationConfig* location,
                             HttpResponse* response) const;
-  void ServeRegularFile(const std::string& file_path,
+  std::string MakeEntityTag(const struct stat& st) const;
+  bool EntityTagMatches(const std::string& header_value,
+                        const std::string& etag,
+                        bool weak) const;
+  void SetValidators(const struct stat& st, HttpResponse* response) const;
+  bool CheckPreconditions(const HttpRequest& request,
+                          const struct stat& st,
+                          HttpResponse* response) const;
+  bool ServePrecompressed(const HttpRequest& request,
+                          const std::string& file_path,
+                          const std::string& content_type,
+                          const LocationConfig* location,
+                          HttpResponse* response) const;
+  struct ByteRange {
+    off_t first;
+    off_t last;
+  };
+  bool ParseRangeHeader(const std::string& value, off_t size,
+                        std::vector<ByteRange>* ranges) const;
+  bool IfRangeMatches(const HttpRequest& request, const struct stat& st) const;
+  void ServeRanges(const std::vector<ByteRange>& ranges,
+                   const SharedFd& file,
+                   const struct stat& st,
+                   const std::string& content_type,
+                   HttpResponse* response) const;
+  void ServeRegularFile(const HttpRequest& request,
+                       const std::string& file_path,
+                       const LocationConfig* location,
                        HttpResponse* response) const;
   void HandlePostRequest(const HttpRequest& request,
                         HttpResponse* response,
@@ -0,0 +1,56 @@
+#ifndef WEBSERV_INCLUDES_STATIC_CACHE_H_
+#define WEBSERV_INCLUDES_STATIC_CACHE_H_
+
+#include <sys/stat.h>
+#include <list>
+#include <map>
+#include <string>
+
+#include "../Util/shared_buffer.h"
+
+class LocationConfig;
+
+struct StaticCacheEntry {
+  std::string file_path;
+  std::string content_type;
+  struct stat st;
+  SharedBuffer body;
+};
+
+// Bodies of small static files keyed by (location, request path). Entries
+// are shared with the output queues that send them and evicted in LRU
+// order once the location's static_cache max_size is exceeded.
+class StaticCache {
+ public:
+  static StaticCache& Instance();
+
+  const StaticCacheEntry* Find(const LocationConfig* location,
+                               const std::string& request_path);
+  void Store(const LocationConfig* location, const std::string& request_path,
+             const StaticCacheEntry& entry, std::size_t max_size);
+  void Remove(const LocationConfig* location, const std::string& request_path);
+  void Clear();
+
+  static bool IsCurrent(const StaticCacheEntry& entry, const struct stat& st);
+
+ private:
+  typedef std::pair<const LocationConfig*, std::string> Key;
+
+  struct Node {
+    StaticCacheEntry entry;
+    std::list<Key>::iterator lru;
+  };
+
+  StaticCache();
+  ~StaticCache();
+  StaticCache(const StaticCache&);
+  StaticCache& operator=(const StaticCache&);
+
+  void Erase(std::map<Key, Node>::iterator it);
+
+  std::map<Key, Node> entries_;
+  std::list<Key> lru_;
+  std::size_t used_bytes_;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef BUFFER_CHAIN_H
+#define BUFFER_CHAIN_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "shared_buffer.h"
+
+// Byte string stored as a sequence of shared buffers. Copies and slices
+// reference the same blocks instead of duplicating payload. Bytes appended
+// from raw memory collect in a private tail that is sealed into a shared
+// block once it is full or the chain is read by buffer.
+class BufferChain {
+ public:
+  static const std::size_t npos = static_cast<std::size_t>(-1);
+
+  BufferChain();
+  BufferChain(const BufferChain& other);
+  BufferChain& operator=(const BufferChain& other);
+
+  void Append(const SharedBuffer& buffer);
+  void Append(const char* data, std::size_t length);
+  void Clear();
+
+  std::size_t Size() const;
+  bool Empty() const;
+  std::size_t Find(const std::string& needle, std::size_t from = 0) const;
+  std::string Substr(std::size_t offset, std::size_t length) const;
+  BufferChain Slice(std::size_t offset, std::size_t length = npos) const;
+
+  std::size_t BufferCount() const;
+  const SharedBuffer& Buffer(std::size_t index) const;
+
+ private:
+  static const std::size_t kBlockSize = 16 * 1024;
+
+  void Seal() const;
+  char At(std::size_t* buffer, std::size_t* offset) const;
+
+  mutable std::vector<SharedBuffer> buffers_;
+  mutable std::string tail_;
+  std::size_t size_;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef HTTP_DATE_H
+#define HTTP_DATE_H
+
+#include <ctime>
+#include <string>
+
+// Date header value shared by every response. The event loop calls Update
+// once per iteration; the string is only reformatted when the second
+// changes.
+class HttpDate {
+ public:
+  static const std::string& Now();
+  static void Update();
+  static void Update(std::time_t now);
+
+ private:
+  static std::time_t& CachedTime();
+  static std::string& CachedValue();
+};
+
+#endif
@@ -11,6 +11,8 @@ std::string FT_ToLower(const std::string &str);
 std::string FT_ToUpper(const std::string &str);
 std::string FT_StrCapitalize(const std::string &str);
 std::string FT_GetGMTDate();
+std::string FT_FormatHttpDate(std::time_t time);
+bool FT_ParseHttpDate(const std::string &str, std::time_t *out);
 std::string FT_Ipv4ToString(const struct in_addr &inAddr);
 
 }  // namespace libft
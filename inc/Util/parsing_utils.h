@@ -32,6 +32,7 @@ void UpdateState(
 std::string RemoveComments(const std::string& str);
 
 std::string UrlDecode(const std::string& str);
+bool NormalizePath(const std::string& path, bool decode, std::string& out);
 
 }  // namespace parsing_utils
 
@@ -0,0 +1,38 @@
+#ifndef SHARED_BUFFER_H
+#define SHARED_BUFFER_H
+
+#include <cstddef>
+#include <string>
+
+// Immutable, reference-counted byte buffer. Copies and slices share the same
+// storage, so one cached body can sit in many output queues at once.
+class SharedBuffer {
+ public:
+  SharedBuffer();
+  explicit SharedBuffer(const std::string& data);
+  SharedBuffer(const SharedBuffer& other);
+  ~SharedBuffer();
+  SharedBuffer& operator=(const SharedBuffer& other);
+
+  static SharedBuffer Adopt(std::string& data);
+  SharedBuffer Slice(std::size_t offset, std::size_t length) const;
+
+  const char* Data() const;
+  std::size_t Size() const;
+  bool Empty() const;
+  std::string ToString() const;
+
+ private:
+  struct Block {
+    std::string data;
+    std::size_t refs;
+  };
+
+  void Release();
+
+  Block* block_;
+  std::size_t offset_;
+  std::size_t length_;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SHARED_FD_H
+#define SHARED_FD_H
+
+#include <cstddef>
+
+// Reference-counted file descriptor, closed when the last copy goes away.
+// Lets several queued body segments refer to one open file.
+class SharedFd {
+ public:
+  SharedFd();
+  explicit SharedFd(int fd);
+  SharedFd(const SharedFd& other);
+  ~SharedFd();
+  SharedFd& operator=(const SharedFd& other);
+
+  int Get() const;
+  bool Valid() const;
+
+ private:
+  struct Block {
+    int fd;
+    std::size_t refs;
+  };
+
+  void Release();
+
+  Block* block_;
+};
+
+#endif
@@ -3,12 +3,14 @@
 
 #include <iostream>
 
+#include "../Response/body_filter.h"
 #include "../Response/http_response.h"
 #include "../Response/response_builder.h"
 #include "../Cgi/cgi_handler.h"
 #include "../Web/epoll_handler.h"
 #include "../Exception/http_exception.h"
 #include "../Request/request_parser.h"
+#include "output_queue.h"
 
 #define BUFFER_SIZE 4096
 #define CRLF "\r\n"
@@ -19,6 +21,7 @@
 
 class ResponseBuilder;
 class ResponseDirector;
+class FastCgiConnection;
 
 class ClientConnection : public Event {
  public:
@@ -36,7 +39,20 @@ class ClientConnection : public Event {
   void setCgiHandler(CgiHandler* handler);
   CgiHandler* getCgiHandler() const;
   CgiHandler* generateCgiHandler();
-  void handleCgiResponse(const std::string& response);
+  void handleCgiResponse(const BufferChain& response);
+  bool handleCgiHeaders(const BufferChain& output, std::size_t headerEnd);
+  bool handleCgiBody(const SharedBuffer& data);
+  void handleCgiEnd(bool complete);
+  void HandleCgiTimeout();
+  void AttachFastCgi(FastCgiConnection* upstream);
+  void HandleFastCgiResponse(int status, const BufferChain& response);
+  void WaitForCgiCache(const HttpRequest& request, const LocationConfig* location,
+                       const std::string& key);
+  void ResumeCgiCacheWait();
+  bool CgiCacheLockBypassed() const;
+  void WaitForCgiSlot(const HttpRequest& request, const LocationConfig* location);
+  bool ResumeCgiSlotWait(const LocationConfig* location);
+  bool TakeCgiSlot(const LocationConfig* location);
 
   void KillCgiProcess();
   void SetCgiPid(pid_t pid);
@@ -44,12 +60,14 @@ class ClientConnection : public Event {
 
   void MarkForDeletion();
   bool ShouldDelete() const;
+  void ResumeWriting();
 
  private:
   void HandleRead();
   void HandleWrite();
   void HandleClose();
-  void HandleClientRequest(const HttpRequest& request);
+  void HandleClientRequest(HttpRequest& request);
+  void RetryWaitingRequest();
   void HandleParsingException(const HttpException& e);
   void SetupResponseForSending();
   void UpdateActivity();
@@ -61,24 +79,30 @@ class ClientConnection : public Event {
   void ProcessReadBuffer(bool& is_connection_close);
   void SetupRequestPort(HttpRequest& req);
 
-  void UpdateServerConfig(const HttpRequest &request);
+  void UpdateServerConfig(HttpRequest &request);
   void UpdateTimeouts(const HttpRequest &request);
   bool CheckConnectionCloseHeader(const HttpRequest &request);
 
-  void HandleCgiTimeout();
   void WriteResponseData();
+  void QueueResponse(const HttpResponse* response, bool streaming = false);
+  bool CgiOutputBacklogged() const;
   void HandleEmptyWriteBuffer();
+  void PauseWriting();
 
   void HandleEmptyCgiResponse();
   void HandleErrorCgiResponse(int status);
-  void ParseCgiHeaderAndBody(const std::string &response, std::string::size_type headerEnd);
+  void ParseCgiHeaderAndBody(const BufferChain &response, std::size_t headerEnd);
   void ParseCgiHeaders(const std::string &headerPart);
   bool ParseStatusHeader(const std::string &line);
   void ParseNormalHeader(const std::string &line);
-  void HandleCgiResponseWithoutHeaderEnd(const std::string &response);
+  void HandleCgiResponseWithoutHeaderEnd(const BufferChain &response);
   void FinalizeCgiResponse();
+  void SaveCgiRequest(const HttpRequest &request);
+  bool ServeInternalRedirect();
 
  private:
+  static const off_t kCgiOutputLimit = 256 * 1024;
+
   int fd_;
   bool closed_;
   bool should_close_;
@@ -89,13 +113,27 @@ class ClientConnection : public Event {
   ResponseDirector* director_;
 
   std::string read_buffer_;
-  std::string write_buffer_;
+  OutputQueue output_;
+  BodyPipeline body_;
+  bool write_paused_;
   std::time_t last_activity_;
   std::time_t keepalive_timeout_;
 
   CgiHandler* cgi_handler_;
+  FastCgiConnection* fastcgi_;
   std::time_t cgi_read_timeout_;
   pid_t cgi_pid_;
+  const LocationConfig* location_;
+  bool accepts_gzip_;
+
+  HttpRequest cgi_request_;
+  HttpRequest waiting_request_;
+  std::time_t wait_start_;
+  const LocationConfig* cgi_cache_location_;
+  std::string cgi_cache_key_;
+  bool cgi_cache_lock_bypass_;
+  const LocationConfig* cgi_queue_location_;
+  const LocationConfig* cgi_slot_;
 };
 
 #endif
@@ -0,0 +1,46 @@
+#ifndef OUTPUT_QUEUE_HPP
+#define OUTPUT_QUEUE_HPP
+
+#include <sys/types.h>
+#include <deque>
+#include <string>
+
+#include "../Util/shared_buffer.h"
+#include "../Util/shared_fd.h"
+
+// Pending response bytes for a connection. Memory segments reference shared
+// buffers and are flushed together with writev; file segments go out with
+// sendfile.
+class OutputQueue {
+ public:
+  OutputQueue();
+
+  void Push(const SharedBuffer& buffer);
+  void Push(const SharedBuffer& buffer, std::size_t offset, std::size_t length);
+  void Push(const std::string& data);
+  void Push(const SharedFd& file, off_t offset, off_t length);
+  bool Empty() const;
+  off_t Pending() const;
+  void Clear();
+  bool Write(int fd);
+
+ private:
+  struct Segment {
+    SharedBuffer buffer;
+    std::size_t offset;
+    std::size_t end;
+    SharedFd file;
+    off_t file_offset;
+    off_t file_remaining;
+  };
+
+  static const int kMaxIov = 64;
+
+  bool WriteFile(int fd, Segment* segment);
+  void WriteBuffers(int fd, bool* would_block);
+
+  std::deque<Segment> segments_;
+  off_t pending_;
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include "../../inc/Cgi/cgi_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include "../../inc/Config/location_config.h"
+#include "../../inc/Request/http_request.h"
+#include "../../inc/Util/libft.h"
+
+namespace {
+
+bool ParseSeconds(const std::string& directive, const std::string& name,
+                  std::time_t* out) {
+  if (directive.compare(0, name.size(), name) != 0) {
+    return false;
+  }
+  std::string value = directive.substr(name.size());
+  if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  *out = static_cast<std::time_t>(std::strtol(value.c_str(), NULL, 10));
+  return true;
+}
+
+}  // namespace
+
+CgiCache::CgiCache() {}
+
+CgiCache::~CgiCache() {}
+
+CgiCache& CgiCache::Instance() {
+  static CgiCache instance;
+  return instance;
+}
+
+bool CgiCache::Cacheable(const HttpRequest& request) {
+  return request.GetMethod() == "GET" &&
+         request.GetHeaders().find("authorization") == request.GetHeaders().end();
+}
+
+// "GET host /path?a=1&b=2", with the query parameters in sorted order so
+// that reordered query strings share an entry.
+std::string CgiCache::MakeKey(const HttpRequest& request) {
+  std::string host;
+  std::map<std::string, std::string>::const_iterator it = request.GetHeaders().find("host");
+  if (it != request.GetHeaders().end()) {
+    host = libft::FT_ToLower(it->second);
+  }
+
+  std::vector<std::string> params;
+  std::istringstream query(request.GetQueryString());
+  std::string param;
+  while (std::getline(query, param, '&')) {
+    if (!param.empty()) {
+      params.push_back(param);
+    }
+  }
+  std::sort(params.begin(), params.end());
+
+  std::string key = request.GetMethod() + " " + host + " " + request.GetPath();
+  for (std::size_t i = 0; i < params.size(); ++i) {
+    key += (i == 0 ? "?" : "&") + params[i];
+  }
+  return key;
+}
+
+const CgiCacheEntry* CgiCache::Find(const LocationConfig* location, const std::string& key,
+                                    std::time_t now, bool* stale) {
+  std::map<Key, Node>::iterator it = entries_.find(Key(location, key));
+  if (it == entries_.end()) {
+    return NULL;
+  }
+  if (now >= it->second.entry.stale_until) {
+    Erase(it);
+    return NULL;
+  }
+  std::list<Key>& lru = zones_[location].lru;
+  lru.splice(lru.begin(), lru, it->second.lru);
+  *stale = now >= it->second.entry.expires;
+  return &it->second.entry;
+}
+
+// Only one refresh runs per entry; later stale hits keep serving the old
+// copy until it lands.
+bool CgiCache::BeginRefresh(const LocationConfig* location, const std::string& key) {
+  std::map<Key, Node>::iterator it = entries_.find(Key(location, key));
+  if (it == entries_.end() || it->second.entry.refreshing) {
+    return false;
+  }
+  it->second.entry.refreshing = true;
+  return true;
+}
+
+void CgiCache::EndRefresh(const LocationConfig* location, const std::string& key) {
+  std::map<Key, Node>::iterator it = entries_.find(Key(location, key));
+  if (it != entries_.end()) {
+    it->second.entry.refreshing = false;
+  }
+}
+
+// Takes a script's complete output, header block included. Returns false,
+// leaving any existing entry alone, if the response may not be cached.
+bool CgiCache::Store(const LocationConfig* location, const std::string& key,
+                     const BufferChain& output, std::time_t now) {
+  std::size_t max_size = location->GetCgiCacheMaxSize();
+  CgiCacheEntry entry;
+  std::time_t ttl = 0;
+  std::time_t stale = 0;
+  if (output.Size() > max_size || !ParseOutput(output, &entry) ||
+      !Lifetime(entry, location, now, &ttl, &stale)) {
+    EndRefresh(location, key);
+    return false;
+  }
+  entry.stored = now;
+  entry.expires = now + ttl;
+  entry.stale_until = entry.expires + stale;
+  entry.refreshing = false;
+
+  Key cache_key(location, key);
+  std::map<Key, Node>::iterator it = entries_.find(cache_key);
+  if (it != entries_.end()) {
+    Erase(it);
+  }
+
+  Zone& zone = zones_[location];
+  while (!zone.lru.empty() && zone.used_bytes + output.Size() > max_size) {
+    Erase(entries_.find(zone.lru.back()));
+  }
+
+  zone.lru.push_front(cache_key);
+  Node& node = entries_[cache_key];
+  node.entry = entry;
+  node.size = output.Size();
+  node.lru = zone.lru.begin();
+  zone.used_bytes += node.size;
+  return true;
+}
+
+bool CgiCache::ParseOutput(const BufferChain& output, CgiCacheEntry* entry) {
+  std::size_t header_end = output.Find("\r\n\r\n");
+  if (header_end == BufferChain::npos) {
+    return false;
+  }
+
+  entry->status = 200;
+  entry->reason = "OK";
+  std::istringstream lines(output.Substr(0, header_end));
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (!line.empty() && line[line.size() - 1] == '\r') {
+      line.erase(line.size() - 1);
+    }
+    std::string::size_type colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string name = line.substr(0, colon);
+    std::string value = libft::FT_Trim(line.substr(colon + 1));
+    std::string lower = libft::FT_ToLower(name);
+    if (lower == "status") {
+      entry->status = std::atoi(value.c_str());
+      std::string::size_type space = value.find(' ');
+      entry->reason = space == std::string::npos ? "" : value.substr(space + 1);
+    } else if (lower != "connection" && lower != "transfer-encoding") {
+      entry->headers.push_back(std::make_pair(name, value));
+    }
+  }
+
+  entry->body = output.Slice(header_end + 4);
+  return entry->status == 200;
+}
+
+// Cache-Control from the script wins over Expires, which wins over the
+// location's valid= time. Responses that set cookies, vary on request
+// headers, hand off to a static file or opt out through Cache-Control are
+// not stored.
+bool CgiCache::Lifetime(const CgiCacheEntry& entry, const LocationConfig* location,
+                        std::time_t now, std::time_t* ttl, std::time_t* stale) {
+  *ttl = location->GetCgiCacheValid() / 1000;
+  *stale = location->GetCgiCacheStale() / 1000;
+  bool max_age = false;
+  bool shared_max_age = false;
+
+  for (std::size_t i = 0; i < entry.headers.size(); ++i) {
+    std::string name = libft::FT_ToLower(entry.headers[i].first);
+    std::string value = libft::FT_ToLower(entry.headers[i].second);
+    if (name == "set-cookie" || name == "x-accel-redirect" || name == "x-sendfile" ||
+        (name == "vary" && value != "accept-encoding")) {
+      return false;
+    }
+    if (name != "cache-control") {
+      continue;
+    }
+
+    std::istringstream directives(value);
+    std::string directive;
+    while (std::getline(directives, directive, ',')) {
+      directive = libft::FT_Trim(directive);
+      std::time_t seconds;
+      if (directive == "no-store" || directive == "no-cache" || directive == "private") {
+        return false;
+      } else if (ParseSeconds(directive, "s-maxage=", &seconds)) {
+        *ttl = seconds;
+        shared_max_age = true;
+      } else if (!shared_max_age && ParseSeconds(directive, "max-age=", &seconds)) {
+        *ttl = seconds;
+        max_age = true;
+      } else if (ParseSeconds(directive, "stale-while-revalidate=", &seconds)) {
+        *stale = seconds;
+      }
+    }
+  }
+
+  for (std::size_t i = 0; i < entry.headers.size() && !max_age && !shared_max_age; ++i) {
+    if (libft::FT_ToLower(entry.headers[i].first) == "expires") {
+      std::time_t expires;
+      *ttl = libft::FT_ParseHttpDate(entry.headers[i].second, &expires) ? expires - now : 0;
+      break;
+    }
+  }
+  return *ttl > 0;
+}
+
+void CgiCache::Erase(std::map<Key, Node>::iterator it) {
+  Zone& zone = zones_[it->first.first];
+  zone.used_bytes -= it->second.size;
+  zone.lru.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+// Returns true if nothing is fetching key yet, making the caller the one to
+// run the script. Otherwise client_fd is queued until that run finishes.
+bool CgiCache::Lock(const LocationConfig* location, const std::string& key, int client_fd) {
+  std::map<Key, std::vector<int> >::iterator it = locks_.find(Key(location, key));
+  if (it == locks_.end()) {
+    locks_[Key(location, key)];
+    return true;
+  }
+  it->second.push_back(client_fd);
+  return false;
+}
+
+std::vector<int> CgiCache::Unlock(const LocationConfig* location, const std::string& key) {
+  std::vector<int> waiters;
+  std::map<Key, std::vector<int> >::iterator it = locks_.find(Key(location, key));
+  if (it != locks_.end()) {
+    waiters.swap(it->second);
+    locks_.erase(it);
+  }
+  return waiters;
+}
+
+void CgiCache::CancelWait(const LocationConfig* location, const std::string& key,
+                          int client_fd) {
+  std::map<Key, std::vector<int> >::iterator it = locks_.find(Key(location, key));
+  if (it != locks_.end()) {
+    it->second.erase(std::remove(it->second.begin(), it->second.end(), client_fd),
+                     it->second.end());
+  }
+}
+
+void CgiCache::Clear() {
+  entries_.clear();
+  zones_.clear();
+}
@@ -1,24 +1,70 @@
 #include "../../inc/Cgi/cgi_handler.h"
+#include "../../inc/Cgi/cgi_cache.h"
+#include "../../inc/Cgi/cgi_limiter.h"
+#include "../../inc/Cgi/cgi_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <csignal>
+
+const size_t CgiHandler::kReadBudget;
+std::vector<pid_t> CgiHandler::orphans_;
+std::set<CgiHandler*> CgiHandler::unattended_;
+
+CgiInputWriter::CgiInputWriter(CgiHandler* handler)
+    : handler_(handler)
+{}
+
+void CgiInputWriter::OnEvent(uint32_t events)
+{
+    (void)events;
+    handler_->onInputWritable();
+}
+
+int CgiInputWriter::getFd() const
+{
+    return handler_->getInputFd();
+}
+
+CgiExitWatcher::CgiExitWatcher(CgiHandler* handler)
+    : handler_(handler)
+{}
+
+void CgiExitWatcher::OnEvent(uint32_t events)
+{
+    (void)events;
+    handler_->onChildExited();
+}
+
+int CgiExitWatcher::getFd() const
+{
+    return handler_->getPidFd();
+}
 
 CgiHandler::CgiHandler()
-    : childPid(-1), exitStatus(0), isCompleted(false), isRegistered(false), response(NULL), clientFd(-1), executor(), pid(-1), startTime(std::time(NULL)), timeout(60000), state_(CGI_IDLE)
+    : childPid(-1), exitStatus(0), bodyWritten_(0), inputWriter_(this), inputRegistered_(false), exitWatcher_(this), exitRegistered_(false), isCompleted(false), isRegistered(false), response(NULL), clientFd(-1), executor(), pid(-1), startTime(std::time(NULL)), timeout(60000), state_(CGI_IDLE), poolLocation_(NULL), headerScan_(0), streaming_(false), paused_(false), cacheLocation_(NULL), cacheRefresh_(false), cacheLocked_(false), slotLocation_(NULL)
 {}
 
 void CgiHandler::OnEvent(uint32_t events)
 {
-    if (state_ != CGI_READING) return;
+    if (state_ != CGI_READING && state_ != CGI_ERROR) return;
 
-    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
     {
         ReadOutputPipes();
-        CheckChildProcessStatus();
+        if (!childPidFd_.valid() || getFd() == -1)
+        {
+            CheckChildProcessStatus();
+        }
 
         if (isTimedOut())
         {
             setState(CGI_TIMEOUT);
             handleCgiCompletion();
         }
-        else if (isComplete() || getFd() == -1)
+        else if (getFd() == -1)
         {
             setState(CGI_COMPLETED);
             handleCgiCompletion();
@@ -32,34 +78,110 @@ void CgiHandler::ReadOutputPipes()
     ReadFromErrorPipe();
 }
 
+// Reads what the script has written so far, up to a budget per event so
+// one busy script cannot hold up the loop. Output is buffered only until
+// the end of its header block; the body after it goes straight to the
+// client.
 void CgiHandler::ReadFromOutputPipe()
 {
-    char buffer[4096];
-    ssize_t n;
+    char buffer[16384];
+    size_t budget = kReadBudget;
 
-    if (getFd() != -1)
+    while (getFd() != -1 && !paused_ && budget > 0)
     {
-        while ((n = read(getFd(), buffer, sizeof(buffer) - 1)) > 0)
+        ssize_t n = read(getFd(), buffer, sizeof(buffer));
+        if (n > 0)
+        {
+            startTime = std::time(NULL);
+            budget -= std::min(budget, static_cast<size_t>(n));
+            deliverOutput(buffer, n);
+        }
+        else if (n == -1 && errno == EINTR)
         {
-            if (isTimedOut())
+            continue;
+        }
+        else
+        {
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
             {
-                handleCgiCompletion();
-                return;
+                outputPipeRead_.closeIfValid();
             }
-            buffer[n] = '\0';
-            outputContent.append(buffer, n);
-            usleep(10000);
+            break;
         }
+    }
+}
 
-        if (n == 0 || (n == -1))
+void CgiHandler::deliverOutput(const char *data, size_t length)
+{
+    ClientConnection *client = EpollHandler::Instance().FindClientByFd(clientFd);
+
+    if (cacheLocation_ != NULL)
+    {
+        cacheOutput_.Append(data, length);
+        if (cacheOutput_.Size() > cacheLocation_->GetCgiCacheMaxSize())
         {
-            outputPipeRead_.closeIfValid();
+            finishCaching();
         }
-        if (isRegisteredToEpoll())
+    }
+
+    // Without a client only the cache wants the output, and once caching
+    // is given up nothing does.
+    if (clientFd < 0)
+    {
+        return;
+    }
+
+    if (streaming_)
+    {
+        if (client && !client->handleCgiBody(SharedBuffer(std::string(data, length))))
         {
-            EpollHandler::Instance().UnregisterEvent(this);
-            isRegistered = false;
+            pauseOutput();
         }
+        return;
+    }
+
+    outputContent.Append(data, length);
+    size_t headerEnd = outputContent.Find("\r\n\r\n", headerScan_);
+    headerScan_ = outputContent.Size() < 3 ? 0 : outputContent.Size() - 3;
+    if (headerEnd == BufferChain::npos || !client)
+    {
+        return;
+    }
+
+    streaming_ = true;
+    if (!client->handleCgiHeaders(outputContent, headerEnd))
+    {
+        pauseOutput();
+    }
+    outputContent.Clear();
+}
+
+// Backpressure: while the client still has a full buffer of this script's
+// output to send, the pipe is dropped from epoll and the script blocks on
+// its next write.
+void CgiHandler::pauseOutput()
+{
+    if (paused_)
+        return;
+
+    paused_ = true;
+    if (isRegistered)
+    {
+        EpollHandler::Instance().UnregisterEvent(this);
+        isRegistered = false;
+    }
+}
+
+void CgiHandler::resumeOutput()
+{
+    if (!paused_)
+        return;
+
+    paused_ = false;
+    startTime = std::time(NULL);
+    if (getFd() != -1 && EpollHandler::Instance().RegisterEvent(this, EPOLLIN))
+    {
+        isRegistered = true;
     }
 }
 
@@ -70,21 +192,15 @@ void CgiHandler::ReadFromErrorPipe()
 
     if (getErrorPipe() != -1)
     {
-        while ((n = read(getErrorPipe(), buffer, sizeof(buffer) - 1)) > 0)
+        while ((n = read(getErrorPipe(), buffer, sizeof(buffer))) > 0)
         {
-            buffer[n] = '\0';
             errorContent.append(buffer, n);
         }
 
-        if (n == 0 || (n == -1))
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
         {
             errorPipeRead_.closeIfValid();
         }
-        if (isRegisteredToEpoll())
-        {
-            EpollHandler::Instance().UnregisterEvent(this);
-            isRegistered = false;
-        }
     }
 }
 
@@ -99,9 +215,121 @@ void CgiHandler::CheckChildProcessStatus()
         {
             exitStatus = 0;
             ProcessChildExitStatus(status);
+        }
+        if (result == childPid || (result == -1 && errno == ECHILD))
+        {
+            ClientConnection *client = EpollHandler::Instance().FindClientByFd(clientFd);
+            if (client && client->getCgiHandler() == this)
+            {
+                client->SetCgiPid(-1);
+            }
             childPid = -1;
+            stopWatchingChild();
+        }
+    }
+}
+
+// Without pidfd support the child is polled from OnEvent instead, and from
+// reapOrphans once its handler is abandoned.
+void CgiHandler::watchChild()
+{
+    int fd = static_cast<int>(syscall(SYS_pidfd_open, childPid, 0));
+    if (fd < 0)
+    {
+        return;
+    }
+
+    childPidFd_.reset(fd);
+    if (EpollHandler::Instance().RegisterEvent(&exitWatcher_, EPOLLIN))
+    {
+        exitRegistered_ = true;
+    }
+    else
+    {
+        childPidFd_.closeIfValid();
+    }
+}
+
+void CgiHandler::stopWatchingChild()
+{
+    if (exitRegistered_)
+    {
+        EpollHandler::Instance().UnregisterEvent(&exitWatcher_);
+        exitRegistered_ = false;
+    }
+    childPidFd_.closeIfValid();
+}
+
+// Also runs after the request is finished: a script killed on timeout or
+// client abort is reaped here once it is gone.
+void CgiHandler::onChildExited()
+{
+    CheckChildProcessStatus();
+}
+
+// The handler is being abandoned with its script signalled but maybe still
+// running. With a pidfd the exit watcher reaps it; otherwise the pid goes
+// on a list the event loop polls, so that it does not stay a zombie.
+void CgiHandler::orphanChild()
+{
+    if (childPid <= 0 || childPidFd_.valid())
+        return;
+
+    orphans_.push_back(childPid);
+    childPid = -1;
+}
+
+// A handler without a client, such as a background cache refresh, has no
+// connection whose timeout check would stop it, so the event loop checks
+// cgi_read_timeout for it directly.
+void CgiHandler::watchUnattended()
+{
+    unattended_.insert(this);
+}
+
+void CgiHandler::expireUnattended()
+{
+    std::vector<CgiHandler*> expired;
+    for (std::set<CgiHandler*>::iterator it = unattended_.begin(); it != unattended_.end(); ++it)
+    {
+        if ((*it)->isTimedOut())
+        {
+            expired.push_back(*it);
         }
     }
+
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+        CgiHandler *handler = expired[i];
+        if (handler->poolLocation_ != NULL)
+        {
+            CgiPool::Instance().Cancel(handler);
+        }
+        handler->setState(CGI_TIMEOUT);
+        handler->handleCgiCompletion();
+    }
+}
+
+void CgiHandler::reapOrphans()
+{
+    for (size_t i = 0; i < orphans_.size();)
+    {
+        pid_t result = waitpid(orphans_[i], NULL, WNOHANG);
+        if (result == orphans_[i] || (result == -1 && errno == ECHILD))
+        {
+            orphans_[i] = orphans_.back();
+            orphans_.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+int CgiHandler::getPidFd() const
+{
+    return childPidFd_.get();
 }
 
 void CgiHandler::ProcessChildExitStatus(int status)
@@ -127,28 +355,80 @@ void CgiHandler::ProcessChildExitStatus(int status)
 
 void CgiHandler::handleCgiCompletion()
 {
-    std::string responseBody;
+    BufferChain responseBody;
     ClientConnection *client = EpollHandler::Instance().FindClientByFd(clientFd);
     bool hasError = false;
 
-    PrepareResponseBody(responseBody, hasError);
-    if (client)
+    unattended_.erase(this);
+    finishCaching();
+
+    if (streaming_)
     {
-        client->handleCgiResponse(responseBody);
-        client->SetCgiPid(-1);
+        if (client)
+        {
+            client->handleCgiEnd(state_ == CGI_COMPLETED);
+            client->SetCgiPid(-1);
+        }
+    }
+    else
+    {
+        PrepareResponseBody(responseBody, hasError);
+        if (client)
+        {
+            client->handleCgiResponse(responseBody);
+            client->SetCgiPid(-1);
+        }
     }
 
     UnregisterAndCleanup();
 
-    if (client)
+    if (client || clientFd < 0)
     {
         EpollHandler::Instance().InvalidateEvent(this);
         EpollHandler::Instance().ScheduleForDeletion(this);
+    }
+    if (client)
+    {
         client->setCgiHandler(NULL);
     }
+    releaseSlot();
+}
+
+// Also called early, once the output outgrows the cache, and when the
+// request is abandoned. A refresh that ends without storing clears the
+// entry's refreshing mark so that a later stale hit can try again. Requests
+// waiting on this run's lock are woken to look up the cache again.
+void CgiHandler::finishCaching()
+{
+    if (cacheLocation_ == NULL)
+        return;
+
+    const LocationConfig *location = cacheLocation_;
+    bool complete = state_ == CGI_COMPLETED && errorContent.empty();
+    if (!(complete && CgiCache::Instance().Store(location, cacheKey_, cacheOutput_,
+                                                 std::time(NULL))) && cacheRefresh_)
+    {
+        CgiCache::Instance().EndRefresh(location, cacheKey_);
+    }
+    cacheLocation_ = NULL;
+    cacheOutput_.Clear();
+
+    if (cacheLocked_)
+    {
+        cacheLocked_ = false;
+        std::vector<int> waiters = CgiCache::Instance().Unlock(location, cacheKey_);
+        for (size_t i = 0; i < waiters.size(); ++i)
+        {
+            ClientConnection *waiter = EpollHandler::Instance().FindClientByFd(waiters[i]);
+            if (waiter)
+            {
+                waiter->ResumeCgiCacheWait();
+            }
+        }
+    }
 }
 
-void CgiHandler::PrepareResponseBody(std::string &responseBody, bool &hasError)
+void CgiHandler::PrepareResponseBody(BufferChain &responseBody, bool &hasError)
 {
     if (isTimedOut() && !isCompleted)
     {
@@ -158,7 +438,7 @@ void CgiHandler::PrepareResponseBody(std::string &responseBody, bool &hasError)
     {
         HandleErrorResponse(hasError);
     }
-    else if (outputContent.empty())
+    else if (outputContent.Empty())
     {
         HandleEmptyOutputResponse(hasError);
     }
@@ -222,11 +502,11 @@ void CgiHandler::HandleEmptyOutputResponse(bool &hasError)
     hasError = true;
 }
 
-void CgiHandler::HandleClientResponse(ClientConnection *client, const std::string &responseBody, bool hasError)
+void CgiHandler::HandleClientResponse(ClientConnection *client, const BufferChain &responseBody, bool hasError)
 {
     if (client)
     {
-        if ((isTimedOut() && !isCompleted) || !errorContent.empty() || outputContent.empty())
+        if ((isTimedOut() && !isCompleted) || !errorContent.empty() || outputContent.Empty())
         {
             if (response)
             {
@@ -255,6 +535,7 @@ void CgiHandler::UnregisterAndCleanup()
         EpollHandler::Instance().UnregisterEvent(this);
         isRegistered = false;
     }
+    finishInput();
 
     cleanup();
 }
@@ -280,8 +561,23 @@ void CgiHandler::executeCgi(const ServerConfig &server, const HttpRequest &reque
     createPipes();
     setupEnvironment(server, request, scriptPath);
 
-    if (!execute())
+    // A handler that fails to start is abandoned without ever being
+    // registered, so its pipes are closed here.
+    bool started = false;
+    try
+    {
+        started = execute();
+    }
+    catch (...)
+    {
+        finishInput();
+        cleanupPipes();
+        throw;
+    }
+    if (!started)
     {
+        finishInput();
+        cleanupPipes();
         throw std::runtime_error("Failed to execute CGI script");
     }
 }
@@ -290,23 +586,38 @@ bool CgiHandler::execute()
 {
     setState(CGI_EXECUTING);
 
-    childPid = fork();
-    if (childPid == -1)
+    if (poolLocation_ != NULL)
     {
-        errorContent = "Fork failed: Could not create process";
-        setState(CGI_ERROR);
-        return false;
+        if (!writeRequestBody())
+        {
+            return false;
+        }
+        if (!CgiPool::Instance().Submit(poolLocation_, this))
+        {
+            throw ServiceUnavailableException();
+        }
+        return true;
     }
 
-    if (childPid == 0)
+    int fds[3];
+    getChildFds(fds);
+    char **env = prepareEnvironment();
+    childPid = SpawnScript(executor, scriptPath, env, fds);
+    for (char **entry = env; *entry != NULL; ++entry)
     {
-        if(childPid % 2 == 0)
-            usleep(10000);
-        setupChildProcess();
-        std::exit(1);
+        delete[] *entry;
+    }
+    delete[] env;
+
+    if (childPid == -1)
+    {
+        errorContent = "Spawn failed: Could not create process";
+        setState(CGI_ERROR);
+        return false;
     }
 
     pid = childPid;
+    watchChild();
 
     ClientConnection *client = EpollHandler::Instance().FindClientByFd(clientFd);
     if (client)
@@ -326,34 +637,53 @@ bool CgiHandler::execute()
     return true;
 }
 
-void CgiHandler::setupChildProcess()
+// posix_spawn runs the child through clone(CLONE_VM | CLONE_VFORK), so
+// unlike fork no page tables are copied and starting a script costs the
+// same however much memory the server holds. The child gets the pipes as
+// stdio, none of the server's other descriptors, the script's directory as
+// its working directory and the default SIGPIPE disposition.
+pid_t CgiHandler::SpawnScript(const std::string &executor, const std::string &scriptPath,
+                              char **env, const int fds[3])
 {
-    dup2(inputPipeRead_.get(), STDIN_FILENO);
-    dup2(outputPipeWrite_.get(), STDOUT_FILENO);
-    dup2(errorPipeWrite_.get(), STDERR_FILENO);
-
-    closeAllPipes();
-
-    std::string scriptDir = scriptPath;
-    size_t lastSlash = scriptDir.find_last_of('/');
-    if (lastSlash != std::string::npos) {
-        scriptDir = scriptDir.substr(0, lastSlash);
-        if (!scriptDir.empty()) {
-            chdir(scriptDir.c_str());
-        }
+    std::string scriptDir;
+    size_t lastSlash = scriptPath.find_last_of('/');
+    if (lastSlash != std::string::npos && lastSlash > 0)
+    {
+        scriptDir = scriptPath.substr(0, lastSlash);
     }
 
-    char **env = prepareEnvironment();
-
-    if (executor.empty())
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[2], STDERR_FILENO);
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+    if (!scriptDir.empty())
     {
-        std::exit(1);
+        posix_spawn_file_actions_addchdir_np(&actions, scriptDir.c_str());
     }
 
-    char *args[] = {(char *)executor.c_str(), (char *)scriptPath.c_str(), NULL};
-    execve(executor.c_str(), args, env);
-    std::cout << "execve failed" << std::endl;
-    std::exit(1);
+    posix_spawnattr_t attr;
+    sigset_t defaults;
+    posix_spawnattr_init(&attr);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    char *args[] = {const_cast<char *>(executor.c_str()),
+                    const_cast<char *>(scriptPath.c_str()), NULL};
+    pid_t child = -1;
+    int result = posix_spawn(&child, executor.c_str(), &actions, &attr, args, env);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (result != 0)
+    {
+        errno = result;
+        return -1;
+    }
+    return child;
 }
 
 bool CgiHandler::setupParentProcess()
@@ -371,7 +701,6 @@ bool CgiHandler::setupParentProcess()
         return false;
     }
 
-    inputPipeWrite_.closeIfValid();
     setState(CGI_READING);
     return true;
 }
@@ -402,11 +731,22 @@ bool CgiHandler::terminateChildProcess(pid_t pid)
 
 CgiHandler::~CgiHandler()
 {
+    unattended_.erase(this);
+    finishCaching();
+    releaseSlot();
+
+    if (poolLocation_ != NULL)
+    {
+        CgiPool::Instance().Cancel(this);
+    }
+
     if (isRegistered)
     {
         EpollHandler::Instance().UnregisterEvent(this);
         isRegistered = false;
     }
+    finishInput();
+    stopWatchingChild();
 
     if (childPid > 0)
     {
@@ -462,52 +802,59 @@ void CgiHandler::cleanupPipes()
 
 void CgiHandler::setupEnvironment(const ServerConfig &server, const HttpRequest &request, const std::string &scriptPath)
 {
-    envVars.clear();
-    SetupBasicEnvironment(request, scriptPath);
-    SetupServerVariables(server);
-    SetupRequestVariables(request);
-    SetupContentVariables(request);
+    envVars = BuildEnvironment(server, request, scriptPath);
 }
 
-void CgiHandler::SetupBasicEnvironment(const HttpRequest &request, const std::string &scriptPath)
+CgiHandler::EnvMap CgiHandler::BuildEnvironment(const ServerConfig &server, const HttpRequest &request,
+                                                const std::string &scriptPath)
 {
-    envVars["GATEWAY_INTERFACE"] = "CGI/1.1";
-    envVars["SERVER_PROTOCOL"] = request.GetVersion();
-    envVars["REQUEST_METHOD"] = request.GetMethod();
-    envVars["SCRIPT_FILENAME"] = scriptPath;
-    envVars["REDIRECT_STATUS"] = "200";
-    envVars["SERVER_SOFTWARE"] = "johnx/1.0.0";
+    EnvMap env;
+    SetupBasicEnvironment(env, request, scriptPath);
+    SetupServerVariables(env, server);
+    SetupRequestVariables(env, request);
+    SetupContentVariables(env, request);
+    return env;
+}
+
+void CgiHandler::SetupBasicEnvironment(EnvMap &env, const HttpRequest &request, const std::string &scriptPath)
+{
+    env["GATEWAY_INTERFACE"] = "CGI/1.1";
+    env["SERVER_PROTOCOL"] = request.GetVersion();
+    env["REQUEST_METHOD"] = request.GetMethod();
+    env["SCRIPT_FILENAME"] = scriptPath;
+    env["REDIRECT_STATUS"] = "200";
+    env["SERVER_SOFTWARE"] = "johnx/1.0.0";
 
     if (request.GetHeaders().find("host") != request.GetHeaders().end())
     {
-        envVars["SERVER_NAME"] = request.GetHeaders().at("host");
+        env["SERVER_NAME"] = request.GetHeaders().at("host");
     }
     else
     {
-        envVars["SERVER_NAME"] = "localhost";
+        env["SERVER_NAME"] = "localhost";
     }
 }
 
-void CgiHandler::SetupServerVariables(const ServerConfig &server)
+void CgiHandler::SetupServerVariables(EnvMap &env, const ServerConfig &server)
 {
     const std::vector<ListenDirective> &directives = server.GetListenDirectives();
     if (!directives.empty())
     {
         std::stringstream ss;
         ss << directives[0].port;
-        envVars["SERVER_PORT"] = ss.str();
-        envVars["REMOTE_ADDR"] = directives[0].host;
+        env["SERVER_PORT"] = ss.str();
+        env["REMOTE_ADDR"] = directives[0].host;
     }
 }
 
-void CgiHandler::SetupRequestVariables(const HttpRequest &request)
+void CgiHandler::SetupRequestVariables(EnvMap &env, const HttpRequest &request)
 {
-    envVars["SCRIPT_NAME"] = request.GetPath();
-    envVars["QUERY_STRING"] = request.GetQueryString();
-    envVars["REQUEST_URI"] = request.GetPath();
+    env["SCRIPT_NAME"] = request.GetPath();
+    env["QUERY_STRING"] = request.GetQueryString();
+    env["REQUEST_URI"] = request.GetPath();
 }
 
-void CgiHandler::SetupContentVariables(const HttpRequest &request)
+void CgiHandler::SetupContentVariables(EnvMap &env, const HttpRequest &request)
 {
     const std::map<std::string, std::string> &headers = request.GetHeaders();
 
@@ -518,19 +865,19 @@ void CgiHandler::SetupContentVariables(const HttpRequest &request)
 
         if (lowerHeaderName == "content-type")
         {
-            envVars["CONTENT_TYPE"] = it->second;
+            env["CONTENT_TYPE"] = it->second;
         }
         else if (lowerHeaderName == "content-length")
         {
-            envVars["CONTENT_LENGTH"] = it->second;
+            env["CONTENT_LENGTH"] = it->second;
         }
     }
 
-    if (request.GetMethod() == "POST" && envVars.find("CONTENT_LENGTH") == envVars.end())
+    if (request.GetMethod() == "POST" && env.find("CONTENT_LENGTH") == env.end())
     {
         std::stringstream ss;
         ss << request.GetBody().length();
-        envVars["CONTENT_LENGTH"] = ss.str();
+        env["CONTENT_LENGTH"] = ss.str();
     }
 }
 
@@ -539,49 +886,73 @@ int CgiHandler::getExitStatus() const
     return exitStatus;
 }
 
+// Writes as much of the request body as the stdin pipe takes now; the
+// rest follows from onInputWritable as the script reads, so a large upload
+// neither blocks the loop nor gets cut short.
 bool CgiHandler::writeRequestBody()
 {
-    if (requestBody.empty())
+    writeAvailableInput();
+    if (inputPipeWrite_.get() == -1 || inputRegistered_)
     {
         return true;
     }
 
-    size_t total = 0;
-    size_t left = requestBody.length();
-
-    while (total < requestBody.length())
+    if (!EpollHandler::Instance().RegisterEvent(&inputWriter_, EPOLLOUT))
     {
-        if (!WriteChunk(total, left))
-            return false;
-
-        if (total > 8192)
-            break;
+        return false;
     }
-
+    inputRegistered_ = true;
     return true;
 }
 
-bool CgiHandler::WriteChunk(size_t &total, size_t &left)
+void CgiHandler::onInputWritable()
 {
-    ssize_t written = write(inputPipeWrite_.get(), requestBody.c_str() + total, left);
-    if (written > 0)
+    startTime = std::time(NULL);
+    writeAvailableInput();
+}
+
+// A script that exits or closes stdin early gets no more of the body;
+// that is its choice and not an error.
+void CgiHandler::writeAvailableInput()
+{
+    while (bodyWritten_ < requestBody.length() && inputPipeWrite_.get() != -1)
     {
-        total += written;
-        left -= written;
-        return true;
+        ssize_t written = write(inputPipeWrite_.get(), requestBody.data() + bodyWritten_,
+                                requestBody.length() - bodyWritten_);
+        if (written > 0)
+        {
+            bodyWritten_ += written;
+        }
+        else if (written == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return;
+        }
+        else
+        {
+            break;
+        }
     }
-    else // written == 0 or written < 0
+    finishInput();
+}
+
+void CgiHandler::finishInput()
+{
+    if (inputRegistered_)
     {
-        HandleWriteFailure();
-        return false;
+        EpollHandler::Instance().UnregisterEvent(&inputWriter_);
+        inputRegistered_ = false;
     }
+    inputPipeWrite_.closeIfValid();
+    std::string().swap(requestBody);
 }
 
-void CgiHandler::HandleWriteFailure()
+int CgiHandler::getInputFd() const
 {
-    terminateChildProcess(childPid);
-    childPid = -1;
-    cleanupPipes();
+    return inputPipeWrite_.get();
 }
 
 void CgiHandler::closeAllPipes()
@@ -625,6 +996,8 @@ char **CgiHandler::prepareEnvironment()
 
 bool CgiHandler::isTimedOut() const
 {
+    if (paused_)
+        return false;
     time_t elapsed = std::time(NULL) - startTime;
     return elapsed * 1000 >= timeout;
 }
@@ -642,7 +1015,13 @@ void CgiHandler::cleanup()
     {
         int status;
         pid_t result = waitpid(childPid, &status, WNOHANG);
-        if (result == 0)
+        bool reapLater = result == 0 && childPidFd_.valid();
+        if (reapLater)
+        {
+            // The exit watcher reaps it once the signal lands.
+            kill(childPid, SIGKILL);
+        }
+        else if (result == 0)
         {
             bool terminated = terminateChildProcess(childPid);
             if (!terminated)
@@ -676,7 +1055,11 @@ void CgiHandler::cleanup()
         {
             client->SetCgiPid(-1);
         }
-        childPid = -1;
+        if (!reapLater)
+        {
+            stopWatchingChild();
+            childPid = -1;
+        }
     }
 
     isCompleted = true;
@@ -717,6 +1100,17 @@ int CgiHandler::getClientFd() const
     return clientFd;
 }
 
+// The client has been handed to another response (X-Accel-Redirect). The
+// script is left to finish so that whatever it does after sending its
+// headers still happens; its remaining output is read and dropped, and it
+// is stopped like any other once cgi_read_timeout passes.
+void CgiHandler::detachClient()
+{
+    clientFd = -1;
+    response = NULL;
+    watchUnattended();
+}
+
 void CgiHandler::setExecutor(const std::string &exec)
 {
     executor = exec;
@@ -736,3 +1130,97 @@ void CgiHandler::setState(CgiState s)
 {
     state_ = s;
 }
+
+void CgiHandler::setPool(const LocationConfig *location)
+{
+    poolLocation_ = location;
+}
+
+void CgiHandler::setCache(const LocationConfig *location, const std::string &key, bool refresh)
+{
+    cacheLocation_ = location;
+    cacheKey_ = key;
+    cacheRefresh_ = refresh;
+}
+
+void CgiHandler::holdCacheLock()
+{
+    cacheLocked_ = true;
+}
+
+void CgiHandler::holdSlot(const LocationConfig *location)
+{
+    slotLocation_ = location;
+}
+
+// Hands the location's concurrency slot on, which may start the next
+// queued request's script right away.
+void CgiHandler::releaseSlot()
+{
+    if (slotLocation_ == NULL)
+        return;
+
+    const LocationConfig *location = slotLocation_;
+    slotLocation_ = NULL;
+    CgiLimiter::Instance().Release(location);
+}
+
+const std::string &CgiHandler::getScriptPath() const
+{
+    return scriptPath;
+}
+
+const CgiHandler::EnvMap &CgiHandler::getEnvironment() const
+{
+    return envVars;
+}
+
+void CgiHandler::getChildFds(int *fds) const
+{
+    fds[0] = inputPipeRead_.get();
+    fds[1] = outputPipeWrite_.get();
+    fds[2] = errorPipeWrite_.get();
+}
+
+// The worker holds its own copies of the script's pipe ends once the job
+// has been sent, so ours are closed to let EOF through.
+void CgiHandler::onPoolDispatched()
+{
+    inputPipeRead_.closeIfValid();
+    outputPipeWrite_.closeIfValid();
+    errorPipeWrite_.closeIfValid();
+    setState(CGI_READING);
+}
+
+void CgiHandler::onPoolStarted(pid_t pid)
+{
+    if (pid <= 0)
+    {
+        errorContent = "Fork failed: Could not create process";
+        return;
+    }
+
+    ClientConnection *client = EpollHandler::Instance().FindClientByFd(clientFd);
+    if (client)
+    {
+        client->SetCgiPid(pid);
+    }
+}
+
+void CgiHandler::onPoolExited(int status)
+{
+    ProcessChildExitStatus(status);
+
+    ClientConnection *client = EpollHandler::Instance().FindClientByFd(clientFd);
+    if (client && client->getCgiHandler() == this)
+    {
+        client->SetCgiPid(-1);
+    }
+}
+
+void CgiHandler::onPoolFailed()
+{
+    errorContent = "Failed to hand CGI request to a pool worker";
+    setState(CGI_ERROR);
+    handleCgiCompletion();
+}
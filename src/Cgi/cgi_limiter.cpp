@@ -0,0 +1,52 @@
+#include "../../inc/Cgi/cgi_limiter.h"
+
+#include <algorithm>
+
+#include "../../inc/Config/location_config.h"
+#include "../../inc/Web/client_connection.h"
+
+CgiLimiter::CgiLimiter() {}
+
+CgiLimiter::~CgiLimiter() {}
+
+CgiLimiter& CgiLimiter::Instance() {
+  static CgiLimiter instance;
+  return instance;
+}
+
+// A client_fd of -1 is never queued.
+CgiLimiter::Admission CgiLimiter::Acquire(const LocationConfig* location, int client_fd) {
+  Slots& slots = slots_[location];
+  if (slots.running < location->GetCgiMaxConcurrency()) {
+    ++slots.running;
+    return ADMITTED;
+  }
+  if (client_fd >= 0 && slots.waiting.size() < location->GetCgiQueueSize()) {
+    slots.waiting.push_back(client_fd);
+    return QUEUED;
+  }
+  return REFUSED;
+}
+
+// The slot passes straight to the oldest waiter that still wants it, so a
+// queued request cannot be overtaken by one that arrives later.
+void CgiLimiter::Release(const LocationConfig* location) {
+  Slots& slots = slots_[location];
+  while (!slots.waiting.empty()) {
+    int fd = slots.waiting.front();
+    slots.waiting.pop_front();
+    ClientConnection* client = EpollHandler::Instance().FindClientByFd(fd);
+    if (client && client->ResumeCgiSlotWait(location)) {
+      return;
+    }
+  }
+  if (slots.running > 0) {
+    --slots.running;
+  }
+}
+
+void CgiLimiter::CancelWait(const LocationConfig* location, int client_fd) {
+  Slots& slots = slots_[location];
+  slots.waiting.erase(std::remove(slots.waiting.begin(), slots.waiting.end(), client_fd),
+                      slots.waiting.end());
+}
@@ -0,0 +1,452 @@
+#include "../../inc/Cgi/cgi_pool.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include "../../inc/Cgi/cgi_handler.h"
+#include "../../inc/Web/epoll_handler.h"
+
+namespace {
+
+// Worker to server messages: the script's pid once it is forked, then its
+// wait status once it exits.
+const int32_t kStarted = 'P';
+const int32_t kExited = 'S';
+
+// Seconds an abandoned script gets after SIGTERM before it is killed, so
+// that one ignoring the signal cannot hold its worker forever.
+const std::time_t kKillGrace = 2;
+
+struct WorkerMessage {
+  int32_t type;
+  int32_t value;
+};
+
+bool WriteAll(int fd, const char* data, std::size_t length) {
+  while (length > 0) {
+    ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+bool ReadAll(int fd, char* data, std::size_t length) {
+  while (length > 0) {
+    ssize_t n = read(fd, data, length);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+void Report(int socket, int32_t type, int32_t value) {
+  WorkerMessage message;
+  message.type = type;
+  message.value = value;
+  WriteAll(socket, reinterpret_cast<const char*>(&message), sizeof(message));
+}
+
+// Job frame: a 32-bit payload length followed by NUL-terminated strings,
+// executor, script path, then one "NAME=value" entry per variable. The
+// script's stdin, stdout and stderr ride along with the length.
+std::string EncodeJob(const std::string& executor, const std::string& script,
+                      const std::map<std::string, std::string>& env) {
+  std::string payload;
+  payload.append(executor).push_back('\0');
+  payload.append(script).push_back('\0');
+  for (std::map<std::string, std::string>::const_iterator it = env.begin();
+       it != env.end(); ++it) {
+    payload.append(it->first).append("=").append(it->second).push_back('\0');
+  }
+  uint32_t length = payload.size();
+  return std::string(reinterpret_cast<const char*>(&length), sizeof(length)) + payload;
+}
+
+bool SendJob(int socket, const std::string& frame, const int* fds) {
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  std::memset(control, 0, sizeof(control));
+
+  iovec iov;
+  iov.iov_base = const_cast<char*>(frame.data());
+  iov.iov_len = frame.size();
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(3 * sizeof(int));
+  std::memcpy(CMSG_DATA(header), fds, 3 * sizeof(int));
+
+  ssize_t n;
+  do {
+    n = sendmsg(socket, &message, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    return false;
+  }
+  return WriteAll(socket, frame.data() + n, frame.size() - n);
+}
+
+bool ReceiveJob(int socket, std::string* payload, int* fds) {
+  uint32_t length = 0;
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  iovec iov;
+  iov.iov_base = &length;
+  iov.iov_len = sizeof(length);
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = recvmsg(socket, &message, MSG_WAITALL);
+  } while (n < 0 && errno == EINTR);
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (n != sizeof(length) || !header || header->cmsg_type != SCM_RIGHTS ||
+      header->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+    return false;
+  }
+  std::memcpy(fds, CMSG_DATA(header), 3 * sizeof(int));
+
+  payload->resize(length);
+  return length == 0 || ReadAll(socket, &(*payload)[0], length);
+}
+
+}  // namespace
+
+CgiWorker::CgiWorker(const LocationConfig* location)
+    : location_(location), fd_(-1), pid_(-1), handler_(NULL), busy_(false), script_pid_(-1),
+      kill_at_(0) {
+}
+
+CgiWorker::~CgiWorker() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+int CgiWorker::getFd() const {
+  return fd_;
+}
+
+bool CgiWorker::Busy() const {
+  return busy_;
+}
+
+// Forks the helper. Everything but its end of the socketpair is closed so
+// scripts do not inherit listening or client sockets.
+bool CgiWorker::Spawn() {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(sv[0]);
+    close(sv[1]);
+    return false;
+  }
+  if (pid == 0) {
+    long max_fd = std::min(sysconf(_SC_OPEN_MAX), 65536L);
+    for (int fd = 3; fd < max_fd; ++fd) {
+      if (fd != sv[1]) {
+        close(fd);
+      }
+    }
+    fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+    Serve(sv[1]);
+  }
+
+  close(sv[1]);
+  fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+  fd_ = sv[0];
+  pid_ = pid;
+  input_.clear();
+  if (!EpollHandler::Instance().RegisterEvent(this, EPOLLIN)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void CgiWorker::Serve(int socket) {
+  std::string payload;
+  int fds[3];
+  while (ReceiveJob(socket, &payload, fds)) {
+    std::vector<char*> strings;
+    for (std::size_t pos = 0; pos < payload.size(); pos += std::strlen(&payload[pos]) + 1) {
+      strings.push_back(&payload[pos]);
+    }
+    if (strings.size() < 2) {
+      std::_Exit(1);
+    }
+    char* argv[] = {strings[0], strings[1], NULL};
+    strings.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      signal(SIGPIPE, SIG_DFL);
+      dup2(fds[0], STDIN_FILENO);
+      dup2(fds[1], STDOUT_FILENO);
+      dup2(fds[2], STDERR_FILENO);
+      close(fds[0]);
+      close(fds[1]);
+      close(fds[2]);
+
+      std::string directory = argv[1];
+      std::string::size_type slash = directory.find_last_of('/');
+      if (slash != std::string::npos && slash > 0) {
+        chdir(directory.substr(0, slash).c_str());
+      }
+      execve(argv[0], argv, &strings[2]);
+      std::_Exit(1);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    close(fds[2]);
+    Report(socket, kStarted, pid);
+
+    int status = 0;
+    if (pid > 0) {
+      while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+      }
+    } else {
+      status = 1 << 8;
+    }
+    Report(socket, kExited, status);
+  }
+  std::_Exit(0);
+}
+
+bool CgiWorker::Run(CgiHandler* handler) {
+  if (fd_ < 0 && !Spawn()) {
+    return false;
+  }
+
+  int fds[3];
+  handler->getChildFds(fds);
+  std::string frame = EncodeJob(handler->getExecutor(), handler->getScriptPath(),
+                                handler->getEnvironment());
+  if (!SendJob(fd_, frame, fds)) {
+    Close();
+    return false;
+  }
+
+  handler_ = handler;
+  busy_ = true;
+  handler->onPoolDispatched();
+  return true;
+}
+
+void CgiWorker::Detach(CgiHandler* handler) {
+  if (handler_ == handler) {
+    handler_ = NULL;
+    kill_at_ = std::time(NULL) + kKillGrace;
+  }
+}
+
+// The helper only reports back once the script exits, so a script still
+// running past its grace period is killed from here. Reports already in
+// the socket are read first, since the pid may have been reaped.
+void CgiWorker::Tick(std::time_t now) {
+  if (kill_at_ == 0 || now < kill_at_) {
+    return;
+  }
+  OnEvent(0);
+  if (kill_at_ != 0 && script_pid_ > 0) {
+    kill(script_pid_, SIGKILL);
+  }
+  kill_at_ = 0;
+}
+
+void CgiWorker::OnEvent(uint32_t events) {
+  char buffer[256];
+  ssize_t n;
+  while ((n = recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+    input_.append(buffer, n);
+  }
+  bool closed = n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ||
+                (events & (EPOLLERR | EPOLLHUP));
+
+  std::size_t pos = 0;
+  while (input_.size() - pos >= sizeof(WorkerMessage)) {
+    WorkerMessage message;
+    std::memcpy(&message, input_.data() + pos, sizeof(message));
+    pos += sizeof(message);
+    if (message.type == kStarted) {
+      script_pid_ = message.value;
+      if (handler_) {
+        handler_->onPoolStarted(message.value);
+      }
+    } else if (message.type == kExited) {
+      if (handler_) {
+        handler_->onPoolExited(message.value);
+      }
+      Finish();
+    }
+  }
+  input_.erase(0, pos);
+
+  // The helper died; the next request respawns it. A script it had
+  // started keeps running and still reaches its handler through the pipes.
+  if (closed) {
+    Close();
+    if (busy_) {
+      Finish();
+    }
+  }
+}
+
+void CgiWorker::Finish() {
+  handler_ = NULL;
+  busy_ = false;
+  script_pid_ = -1;
+  kill_at_ = 0;
+  CgiPool::Instance().OnWorkerIdle(this, location_);
+}
+
+void CgiWorker::Close() {
+  if (fd_ >= 0) {
+    EpollHandler::Instance().UnregisterEvent(this);
+    close(fd_);
+    fd_ = -1;
+  }
+  if (pid_ > 0) {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, NULL, 0);
+    pid_ = -1;
+  }
+  input_.clear();
+}
+
+CgiPool::CgiPool() {
+}
+
+CgiPool::~CgiPool() {
+  for (std::map<const LocationConfig*, Pool>::iterator it = pools_.begin();
+       it != pools_.end(); ++it) {
+    for (std::size_t i = 0; i < it->second.workers.size(); ++i) {
+      delete it->second.workers[i];
+    }
+  }
+}
+
+CgiPool& CgiPool::Instance() {
+  static CgiPool instance;
+  return instance;
+}
+
+// Spawns the workers of every cgi_pool location up front, while the server
+// image is still small and before any listening socket is open.
+void CgiPool::Init(const HttpConfig& config) {
+  const std::vector<ServerConfig*>& servers = config.GetServers();
+  for (std::size_t i = 0; i < servers.size(); ++i) {
+    const std::map<std::string, LocationConfig*>& locations = servers[i]->GetLocations();
+    for (std::map<std::string, LocationConfig*>::const_iterator it = locations.begin();
+         it != locations.end(); ++it) {
+      if (it->second->GetCgiPoolSize() == 0) {
+        continue;
+      }
+      Pool& pool = FindPool(it->second);
+      for (std::size_t w = 0; w < pool.workers.size(); ++w) {
+        pool.workers[w]->Spawn();
+      }
+    }
+  }
+}
+
+bool CgiPool::Submit(const LocationConfig* location, CgiHandler* handler) {
+  Pool& pool = FindPool(location);
+  for (std::size_t i = 0; i < pool.workers.size(); ++i) {
+    if (!pool.workers[i]->Busy() && Dispatch(pool.workers[i], handler)) {
+      return true;
+    }
+  }
+
+  std::size_t limit = location->GetCgiPoolQueue();
+  if (limit != 0 && pool.queue.size() >= limit) {
+    return false;
+  }
+  pool.queue.push_back(handler);
+  return true;
+}
+
+void CgiPool::Cancel(CgiHandler* handler) {
+  for (std::map<const LocationConfig*, Pool>::iterator it = pools_.begin();
+       it != pools_.end(); ++it) {
+    Pool& pool = it->second;
+    pool.queue.erase(std::remove(pool.queue.begin(), pool.queue.end(), handler),
+                     pool.queue.end());
+    for (std::size_t i = 0; i < pool.workers.size(); ++i) {
+      pool.workers[i]->Detach(handler);
+    }
+  }
+}
+
+void CgiPool::OnWorkerIdle(CgiWorker* worker, const LocationConfig* location) {
+  Pool& pool = FindPool(location);
+  while (!pool.queue.empty() && !worker->Busy()) {
+    CgiHandler* handler = pool.queue.front();
+    pool.queue.pop_front();
+    if (!Dispatch(worker, handler)) {
+      handler->onPoolFailed();
+    }
+  }
+}
+
+void CgiPool::Tick() {
+  std::time_t now = std::time(NULL);
+  for (std::map<const LocationConfig*, Pool>::iterator it = pools_.begin();
+       it != pools_.end(); ++it) {
+    for (std::size_t i = 0; i < it->second.workers.size(); ++i) {
+      it->second.workers[i]->Tick(now);
+    }
+  }
+}
+
+CgiPool::Pool& CgiPool::FindPool(const LocationConfig* location) {
+  std::map<const LocationConfig*, Pool>::iterator found = pools_.find(location);
+  if (found != pools_.end()) {
+    return found->second;
+  }
+  Pool& pool = pools_[location];
+  for (std::size_t i = 0; i < location->GetCgiPoolSize(); ++i) {
+    pool.workers.push_back(new CgiWorker(location));
+  }
+  return pool;
+}
+
+// A worker whose helper has died is respawned once before giving up.
+bool CgiPool::Dispatch(CgiWorker* worker, CgiHandler* handler) {
+  return worker->Run(handler) || worker->Run(handler);
+}
@@ -0,0 +1,448 @@
+#include "../../inc/Cgi/fastcgi_client.h"
+
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "../../inc/Web/client_connection.h"
+#include "../../inc/Web/epoll_handler.h"
+
+namespace {
+
+const unsigned char kVersion = 1;
+const unsigned char kBeginRequest = 1;
+const unsigned char kEndRequest = 3;
+const unsigned char kParams = 4;
+const unsigned char kStdin = 5;
+const unsigned char kStdout = 6;
+const unsigned char kResponder = 1;
+const unsigned char kKeepConn = 1;
+const unsigned char kRequestComplete = 0;
+const int kRequestId = 1;
+const std::size_t kHeaderSize = 8;
+const std::size_t kMaxContent = 65535;
+
+void AppendRecord(std::string* out, unsigned char type, const char* data,
+                  std::size_t length) {
+  std::size_t padding = (8 - length % 8) % 8;
+  char header[kHeaderSize] = {
+      static_cast<char>(kVersion), static_cast<char>(type),
+      static_cast<char>(kRequestId >> 8), static_cast<char>(kRequestId & 0xff),
+      static_cast<char>(length >> 8), static_cast<char>(length & 0xff),
+      static_cast<char>(padding), 0};
+  out->append(header, kHeaderSize);
+  out->append(data, length);
+  out->append(padding, '\0');
+}
+
+// Splits a stream into records of at most kMaxContent bytes and ends it
+// with the empty record.
+void AppendStream(std::string* out, unsigned char type, const std::string& data) {
+  for (std::size_t pos = 0; pos < data.size(); pos += kMaxContent) {
+    std::size_t length = std::min(kMaxContent, data.size() - pos);
+    AppendRecord(out, type, data.data() + pos, length);
+  }
+  AppendRecord(out, type, NULL, 0);
+}
+
+void AppendLength(std::string* out, std::size_t length) {
+  if (length < 128) {
+    out->push_back(static_cast<char>(length));
+    return;
+  }
+  out->push_back(static_cast<char>(((length >> 24) & 0x7f) | 0x80));
+  out->push_back(static_cast<char>((length >> 16) & 0xff));
+  out->push_back(static_cast<char>((length >> 8) & 0xff));
+  out->push_back(static_cast<char>(length & 0xff));
+}
+
+}  // namespace
+
+const std::size_t FastCgiClient::kMaxIdlePerUpstream;
+
+FastCgiConnection::FastCgiConnection(const std::string& upstream, int fd, State state)
+    : upstream_(upstream), fd_(fd), state_(state), written_(0), client_(NULL),
+      deadline_ms_(0), reused_(false), received_(false) {
+}
+
+FastCgiConnection::~FastCgiConnection() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+int FastCgiConnection::getFd() const {
+  return fd_;
+}
+
+void FastCgiConnection::OnEvent(uint32_t events) {
+  if (state_ == BROKEN) {
+    return;
+  }
+  // An idle connection has nothing to read; any event means the
+  // application server closed it.
+  if (state_ == IDLE) {
+    FastCgiClient::Instance().Retire(this);
+    return;
+  }
+  if (state_ == CONNECTING && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+    if (!FinishConnect()) {
+      Fail(502);
+      return;
+    }
+  }
+  if (state_ == WRITING && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+    if (!Flush()) {
+      Fail(502);
+      return;
+    }
+  }
+  if (state_ != CONNECTING && (events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))) {
+    Read();
+  }
+}
+
+void FastCgiConnection::Begin(const std::string& request, ClientConnection* client,
+                              time_t deadline_ms, bool reused) {
+  request_ = request;
+  written_ = 0;
+  input_.clear();
+  stdout_.Clear();
+  client_ = client;
+  deadline_ms_ = deadline_ms;
+  reused_ = reused;
+  received_ = false;
+  if (state_ == IDLE) {
+    state_ = WRITING;
+  }
+  EpollHandler::Instance().UpdateEvent(this, EPOLLIN | EPOLLOUT);
+}
+
+bool FastCgiConnection::FinishConnect() {
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+    return false;
+  }
+  state_ = WRITING;
+  return true;
+}
+
+bool FastCgiConnection::Flush() {
+  while (written_ < request_.size()) {
+    ssize_t n = send(fd_, request_.data() + written_, request_.size() - written_,
+                     MSG_NOSIGNAL);
+    if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    written_ += n;
+  }
+  state_ = READING;
+  EpollHandler::Instance().UpdateEvent(this, EPOLLIN);
+  return true;
+}
+
+void FastCgiConnection::Read() {
+  char buffer[16384];
+  bool closed = false;
+  while (true) {
+    ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      received_ = true;
+      input_.append(buffer, n);
+      continue;
+    }
+    closed = !(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    break;
+  }
+  if (!ParseRecords(closed) && closed) {
+    Fail(502);
+  }
+}
+
+// Consumes every complete record in the input buffer. Returns true once the
+// request has been finished, either by END_REQUEST or by a protocol error.
+// A connection the server is closing is never put back in the pool.
+bool FastCgiConnection::ParseRecords(bool closed) {
+  std::size_t pos = 0;
+  while (input_.size() - pos >= kHeaderSize) {
+    const unsigned char* header =
+        reinterpret_cast<const unsigned char*>(input_.data() + pos);
+    std::size_t content = (header[4] << 8) | header[5];
+    std::size_t record = kHeaderSize + content + header[6];
+    if (header[0] != kVersion) {
+      Finish(502, false);
+      return true;
+    }
+    if (input_.size() - pos < record) {
+      break;
+    }
+
+    const char* data = input_.data() + pos + kHeaderSize;
+    int id = (header[2] << 8) | header[3];
+    pos += record;
+    if (id != kRequestId) {
+      continue;
+    }
+    if (header[1] == kStdout) {
+      stdout_.Append(data, content);
+    } else if (header[1] == kEndRequest) {
+      bool complete = content >= 5 && static_cast<unsigned char>(data[4]) == kRequestComplete;
+      bool keep = complete && !closed && state_ == READING && pos == input_.size();
+      Finish(complete ? 200 : 502, keep);
+      return true;
+    }
+  }
+  input_.erase(0, pos);
+  return false;
+}
+
+// A pooled connection the server closed while idle fails before any
+// response bytes arrive; such requests are replayed on a fresh connection.
+void FastCgiConnection::Fail(int status) {
+  if (reused_ && !received_ && FastCgiClient::Instance().Retry(this)) {
+    return;
+  }
+  Finish(status, false);
+}
+
+void FastCgiConnection::Finish(int status, bool keep) {
+  ClientConnection* client = client_;
+  BufferChain output = stdout_;
+  client_ = NULL;
+
+  if (keep) {
+    FastCgiClient::Instance().Release(this);
+  } else {
+    FastCgiClient::Instance().Retire(this);
+  }
+  if (client) {
+    client->HandleFastCgiResponse(status, output);
+  }
+}
+
+void FastCgiConnection::Close() {
+  if (fd_ >= 0) {
+    EpollHandler::Instance().UnregisterEvent(this);
+    close(fd_);
+    fd_ = -1;
+  }
+  state_ = BROKEN;
+}
+
+FastCgiClient::FastCgiClient() {
+}
+
+FastCgiClient::~FastCgiClient() {
+  for (std::vector<FastCgiConnection*>::iterator it = retired_.begin();
+       it != retired_.end(); ++it) {
+    delete *it;
+  }
+}
+
+FastCgiClient& FastCgiClient::Instance() {
+  static FastCgiClient instance;
+  return instance;
+}
+
+FastCgiConnection* FastCgiClient::Start(const std::string& upstream,
+                                        const std::map<std::string, std::string>& params,
+                                        const std::string& body, ClientConnection* client,
+                                        time_t timeout_ms) {
+  Upstream* target = FindUpstream(upstream);
+  if (!target) {
+    return NULL;
+  }
+
+  FastCgiConnection* conn = NULL;
+  bool reused = !target->idle.empty();
+  if (reused) {
+    conn = target->idle.back();
+    target->idle.pop_back();
+  } else {
+    conn = Connect(upstream, *target);
+    if (!conn) {
+      return NULL;
+    }
+  }
+
+  conn->Begin(EncodeRequest(params, body), client, NowMs() + timeout_ms, reused);
+  active_.insert(conn);
+  return conn;
+}
+
+void FastCgiClient::Cancel(FastCgiConnection* conn) {
+  conn->client_ = NULL;
+  Retire(conn);
+}
+
+void FastCgiClient::Tick() {
+  if (!active_.empty()) {
+    time_t now = NowMs();
+    std::vector<FastCgiConnection*> expired;
+    for (std::set<FastCgiConnection*>::iterator it = active_.begin();
+         it != active_.end(); ++it) {
+      if ((*it)->deadline_ms_ <= now) {
+        expired.push_back(*it);
+      }
+    }
+    for (std::size_t i = 0; i < expired.size(); ++i) {
+      expired[i]->Finish(504, false);
+    }
+  }
+
+  for (std::vector<FastCgiConnection*>::iterator it = retired_.begin();
+       it != retired_.end(); ++it) {
+    delete *it;
+  }
+  retired_.clear();
+}
+
+std::string FastCgiClient::EncodeRequest(const std::map<std::string, std::string>& params,
+                                         const std::string& body) {
+  std::string pairs;
+  for (std::map<std::string, std::string>::const_iterator it = params.begin();
+       it != params.end(); ++it) {
+    AppendLength(&pairs, it->first.size());
+    AppendLength(&pairs, it->second.size());
+    pairs.append(it->first);
+    pairs.append(it->second);
+  }
+
+  std::string out;
+  out.reserve(3 * kHeaderSize + 8 + pairs.size() + body.size() +
+              (pairs.size() / kMaxContent + body.size() / kMaxContent + 2) * 2 * kHeaderSize);
+  const char begin[8] = {0, static_cast<char>(kResponder), static_cast<char>(kKeepConn),
+                         0, 0, 0, 0, 0};
+  AppendRecord(&out, kBeginRequest, begin, sizeof(begin));
+  AppendStream(&out, kParams, pairs);
+  AppendStream(&out, kStdin, body);
+  return out;
+}
+
+// Resolves an upstream address once and keeps it with its idle pool.
+FastCgiClient::Upstream* FastCgiClient::FindUpstream(const std::string& address) {
+  std::map<std::string, Upstream>::iterator found = upstreams_.find(address);
+  if (found != upstreams_.end()) {
+    return &found->second;
+  }
+
+  Upstream upstream;
+  std::memset(&upstream.address, 0, sizeof(upstream.address));
+  if (address.compare(0, 5, "unix:") == 0) {
+    sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&upstream.address);
+    std::string path = address.substr(5);
+    if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+      return NULL;
+    }
+    un->sun_family = AF_UNIX;
+    std::memcpy(un->sun_path, path.c_str(), path.size() + 1);
+    upstream.address_length = sizeof(sockaddr_un);
+  } else {
+    std::string::size_type colon = address.rfind(':');
+    if (colon == std::string::npos) {
+      return NULL;
+    }
+    addrinfo hints;
+    addrinfo* result = NULL;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(address.substr(0, colon).c_str(), address.substr(colon + 1).c_str(),
+                    &hints, &result) != 0) {
+      return NULL;
+    }
+    std::memcpy(&upstream.address, result->ai_addr, result->ai_addrlen);
+    upstream.address_length = result->ai_addrlen;
+    freeaddrinfo(result);
+  }
+  return &upstreams_.insert(std::make_pair(address, upstream)).first->second;
+}
+
+FastCgiConnection* FastCgiClient::Connect(const std::string& address,
+                                          const Upstream& upstream) {
+  const sockaddr* target = reinterpret_cast<const sockaddr*>(&upstream.address);
+  int fd = socket(target->sa_family, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  FastCgiConnection::State state = FastCgiConnection::WRITING;
+  if (connect(fd, target, upstream.address_length) < 0) {
+    if (errno != EINPROGRESS) {
+      close(fd);
+      return NULL;
+    }
+    state = FastCgiConnection::CONNECTING;
+  }
+
+  FastCgiConnection* conn = new FastCgiConnection(address, fd, state);
+  if (!EpollHandler::Instance().RegisterEvent(conn, 0)) {
+    delete conn;
+    return NULL;
+  }
+  return conn;
+}
+
+bool FastCgiClient::Retry(FastCgiConnection* conn) {
+  Upstream* upstream = FindUpstream(conn->upstream_);
+  FastCgiConnection* fresh = upstream ? Connect(conn->upstream_, *upstream) : NULL;
+  if (!fresh) {
+    return false;
+  }
+
+  ClientConnection* client = conn->client_;
+  fresh->Begin(conn->request_, client, conn->deadline_ms_, false);
+  active_.insert(fresh);
+  conn->client_ = NULL;
+  Retire(conn);
+  if (client) {
+    client->AttachFastCgi(fresh);
+  }
+  return true;
+}
+
+void FastCgiClient::Release(FastCgiConnection* conn) {
+  active_.erase(conn);
+  Upstream* upstream = FindUpstream(conn->upstream_);
+  if (!upstream || upstream->idle.size() >= kMaxIdlePerUpstream) {
+    Retire(conn);
+    return;
+  }
+
+  conn->state_ = FastCgiConnection::IDLE;
+  conn->request_.clear();
+  conn->input_.clear();
+  conn->stdout_.Clear();
+  EpollHandler::Instance().UpdateEvent(conn, EPOLLIN);
+  upstream->idle.push_back(conn);
+}
+
+// Closes a connection now and deletes it from Tick, after any events
+// already returned for it in this loop iteration have been skipped.
+void FastCgiClient::Retire(FastCgiConnection* conn) {
+  if (conn->state_ == FastCgiConnection::BROKEN) {
+    return;
+  }
+  active_.erase(conn);
+  std::map<std::string, Upstream>::iterator found = upstreams_.find(conn->upstream_);
+  if (found != upstreams_.end()) {
+    std::vector<FastCgiConnection*>& idle = found->second.idle;
+    idle.erase(std::remove(idle.begin(), idle.end(), conn), idle.end());
+  }
+  conn->Close();
+  retired_.push_back(conn);
+}
+
+time_t FastCgiClient::NowMs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
@@ -1,6 +1,11 @@
 #include "../../inc/Config/base_config.h"
 
-BaseConfig::BaseConfig() : client_max_body_size_(1024 * 1024), autoindex_(false), autoindex_set_(false) {}
+BaseConfig::BaseConfig() : client_max_body_size_(1024 * 1024), autoindex_(false), autoindex_set_(false),
+  autoindex_format_("html"), autoindex_page_size_(0),
+  open_file_cache_max_(0), open_file_cache_inactive_(60000), open_file_cache_valid_(60000),
+  open_file_cache_errors_(false), static_cache_max_size_(0), static_cache_max_file_(1024 * 1024),
+  gzip_(false), gzip_types_(1, "text/html"), gzip_min_length_(20), gzip_static_(false),
+  limit_rate_(0), limit_rate_after_(0), types_set_(false) {}
 
 BaseConfig::~BaseConfig() {}
 
@@ -14,8 +19,24 @@ BaseConfig& BaseConfig::operator=(const BaseConfig& other) {
     client_max_body_size_ = other.client_max_body_size_;
     autoindex_ = other.autoindex_;
     autoindex_set_ = other.autoindex_set_;
+    autoindex_format_ = other.autoindex_format_;
+    autoindex_page_size_ = other.autoindex_page_size_;
     error_pages_ = other.error_pages_;
     index_files_ = other.index_files_;
+    open_file_cache_max_ = other.open_file_cache_max_;
+    open_file_cache_inactive_ = other.open_file_cache_inactive_;
+    open_file_cache_valid_ = other.open_file_cache_valid_;
+    open_file_cache_errors_ = other.open_file_cache_errors_;
+    static_cache_max_size_ = other.static_cache_max_size_;
+    static_cache_max_file_ = other.static_cache_max_file_;
+    gzip_ = other.gzip_;
+    gzip_types_ = other.gzip_types_;
+    gzip_min_length_ = other.gzip_min_length_;
+    gzip_static_ = other.gzip_static_;
+    limit_rate_ = other.limit_rate_;
+    limit_rate_after_ = other.limit_rate_after_;
+    types_ = other.types_;
+    types_set_ = other.types_set_;
   }
   return *this;
 }
@@ -57,6 +78,22 @@ bool BaseConfig::IsAutoindexSet() const {
   return autoindex_set_;
 }
 
+void BaseConfig::SetAutoindexFormat(const std::string& format) {
+  autoindex_format_ = format;
+}
+
+const std::string& BaseConfig::GetAutoindexFormat() const {
+  return autoindex_format_;
+}
+
+void BaseConfig::SetAutoindexPageSize(std::size_t page_size) {
+  autoindex_page_size_ = page_size;
+}
+
+std::size_t BaseConfig::GetAutoindexPageSize() const {
+  return autoindex_page_size_;
+}
+
 void BaseConfig::AddIndexFile(const std::string& index_file) {
   index_files_.push_back(index_file);
 }
@@ -68,3 +105,109 @@ const std::vector<std::string>& BaseConfig::GetIndexFiles() const {
 void BaseConfig::ClearIndexFiles() {
   index_files_.clear();
 }
+
+void BaseConfig::SetOpenFileCache(std::size_t max, time_t inactive) {
+  open_file_cache_max_ = max;
+  open_file_cache_inactive_ = inactive;
+}
+
+std::size_t BaseConfig::GetOpenFileCacheMax() const {
+  return open_file_cache_max_;
+}
+
+time_t BaseConfig::GetOpenFileCacheInactive() const {
+  return open_file_cache_inactive_;
+}
+
+void BaseConfig::SetOpenFileCacheValid(time_t valid) {
+  open_file_cache_valid_ = valid;
+}
+
+time_t BaseConfig::GetOpenFileCacheValid() const {
+  return open_file_cache_valid_;
+}
+
+void BaseConfig::SetOpenFileCacheErrors(bool errors) {
+  open_file_cache_errors_ = errors;
+}
+
+bool BaseConfig::GetOpenFileCacheErrors() const {
+  return open_file_cache_errors_;
+}
+
+void BaseConfig::SetStaticCache(std::size_t max_size, std::size_t max_file) {
+  static_cache_max_size_ = max_size;
+  static_cache_max_file_ = max_file;
+}
+
+std::size_t BaseConfig::GetStaticCacheMaxSize() const {
+  return static_cache_max_size_;
+}
+
+std::size_t BaseConfig::GetStaticCacheMaxFile() const {
+  return static_cache_max_file_;
+}
+
+void BaseConfig::SetGzip(bool gzip) {
+  gzip_ = gzip;
+}
+
+bool BaseConfig::GetGzip() const {
+  return gzip_;
+}
+
+void BaseConfig::SetGzipTypes(const std::vector<std::string>& types) {
+  gzip_types_ = types;
+}
+
+const std::vector<std::string>& BaseConfig::GetGzipTypes() const {
+  return gzip_types_;
+}
+
+void BaseConfig::SetGzipMinLength(std::size_t length) {
+  gzip_min_length_ = length;
+}
+
+std::size_t BaseConfig::GetGzipMinLength() const {
+  return gzip_min_length_;
+}
+
+void BaseConfig::SetGzipStatic(bool gzip_static) {
+  gzip_static_ = gzip_static;
+}
+
+bool BaseConfig::GetGzipStatic() const {
+  return gzip_static_;
+}
+
+void BaseConfig::SetLimitRate(std::size_t rate) {
+  limit_rate_ = rate;
+}
+
+std::size_t BaseConfig::GetLimitRate() const {
+  return limit_rate_;
+}
+
+void BaseConfig::SetLimitRateAfter(std::size_t after) {
+  limit_rate_after_ = after;
+}
+
+std::size_t BaseConfig::GetLimitRateAfter() const {
+  return limit_rate_after_;
+}
+
+void BaseConfig::DefineTypes() {
+  if (!types_set_) {
+    types_.Reset();
+    types_set_ = true;
+  }
+}
+
+void BaseConfig::AddType(const std::string& type, const std::string& extension) {
+  DefineTypes();
+  types_.Add(extension, type);
+}
+
+const MimeTypeTable& BaseConfig::GetTypes() const {
+  return types_;
+}
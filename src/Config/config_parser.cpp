@@ -16,24 +16,132 @@ HttpConfig *ConfigParser::Parse(const std::string &filename)
   }
   catch(const std::exception& e)
   {
-    _input.close();
     delete http_config;
     throw;
   }
 
-  _input.close();
   return http_config;
 }
 
 void ConfigParser::OpenConfigFile(const std::string &filename)
 {
-  _input.open(filename.c_str());
-  if (!_input.is_open())
+  std::string content;
+  ReadConfigFile(filename, 0, &content);
+  _input.str(content);
+  _input.clear();
+}
+
+void ConfigParser::ReadConfigFile(const std::string &filename, int depth, std::string *content)
+{
+  static const int kMaxIncludeDepth = 8;
+
+  std::ifstream file(filename.c_str());
+  if (!file.is_open())
+  {
+    if (depth == 0)
+      throw std::runtime_error("Failed to open configuration file");
+    throw std::runtime_error("failed to open included file \"" + filename + "\"");
+  }
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::string trimmed = libft::FT_Trim(parsing_utils::RemoveComments(line));
+    if (trimmed.compare(0, 7, "include") == 0 && trimmed.length() > 7 &&
+        std::isspace(static_cast<unsigned char>(trimmed[7])) &&
+        trimmed[trimmed.length() - 1] == ';')
+    {
+      if (depth >= kMaxIncludeDepth)
+        throw std::runtime_error("too deeply nested \"include\" of \"" + filename + "\"");
+      std::string path = libft::FT_Trim(trimmed.substr(7, trimmed.length() - 8));
+      if (path.empty())
+        throw std::runtime_error("invalid number of arguments in \"include\" directive");
+      ReadConfigFile(ResolveIncludePath(filename, path), depth + 1, content);
+      continue;
+    }
+    content->append(line);
+    content->push_back('\n');
+  }
+}
+
+std::string ConfigParser::ResolveIncludePath(const std::string &including_file,
+                                             const std::string &path)
+{
+  if (path[0] == '/')
+    return path;
+
+  std::string::size_type slash = including_file.find_last_of('/');
+  if (slash == std::string::npos)
+    return path;
+  return including_file.substr(0, slash + 1) + path;
+}
+
+bool ConfigParser::IsTypesBlock() const
+{
+  return _current_line.compare(0, 5, "types") == 0 &&
+         (_current_line.length() == 5 || _current_line[5] == '{' ||
+          std::isspace(static_cast<unsigned char>(_current_line[5])));
+}
+
+void ConfigParser::ParseTypesBlock(BaseConfig *config)
+{
+  _current_line = libft::FT_Trim(_current_line.substr(5));
+  while (_current_line.empty())
+    ReadNextNonEmptyLine();
+  if (_current_line[0] != '{')
+    throw std::runtime_error("expected \"{\" after \"types\"");
+  _current_line = libft::FT_Trim(_current_line.substr(1));
+
+  config->DefineTypes();
+  std::string entry;
+  while (true)
   {
-    throw std::runtime_error("Failed to open configuration file");
+    if (_current_line.empty())
+    {
+      std::string line;
+      if (!std::getline(_input, line))
+        throw std::runtime_error("unexpected end of file, expecting \"}\" in \"types\" block");
+      _current_line = libft::FT_Trim(parsing_utils::RemoveComments(line));
+      continue;
+    }
+
+    std::string::size_type end = _current_line.find_first_of(";}");
+    if (end == std::string::npos)
+    {
+      entry += " " + _current_line;
+      _current_line.clear();
+      continue;
+    }
+
+    entry += " " + _current_line.substr(0, end);
+    char terminator = _current_line[end];
+    _current_line = libft::FT_Trim(_current_line.substr(end + 1));
+    if (terminator == '}')
+    {
+      if (!libft::FT_Trim(entry).empty())
+        throw std::runtime_error("unexpected \"}\" in \"types\" block");
+      return;
+    }
+    AddTypesEntry(entry, config);
+    entry.clear();
   }
 }
 
+void ConfigParser::AddTypesEntry(const std::string &entry, BaseConfig *config)
+{
+  std::string remaining = entry;
+  std::string type = parsing_utils::GetNextToken(remaining);
+  std::string extension = parsing_utils::GetNextToken(remaining);
+
+  if (type.empty() || extension.empty())
+    throw std::runtime_error("invalid number of arguments in \"types\" block");
+
+  do
+  {
+    config->AddType(type, extension);
+  } while (!(extension = parsing_utils::GetNextToken(remaining)).empty());
+}
+
 void ConfigParser::FindAndParseHttpBlock(HttpConfig* http_config)
 {
   bool http_declared = false;
@@ -131,6 +239,10 @@ void ConfigParser::ParseHttpBlock(HttpConfig *http_config)
     {
       ParseServerBlockEntry(http_config);
     }
+    else if (IsTypesBlock())
+    {
+      ParseTypesBlock(http_config);
+    }
     else
     {
       HandleHttpDirectiveLine(http_config);
@@ -166,6 +278,7 @@ void ConfigParser::ParseServerBlockEntry(HttpConfig *http_config)
   try
   {
     ParseServerBlock(server_config);
+    server_config->LoadErrorPages();
     http_config->AddServer(server_config);
   }
   catch (const std::exception &)
@@ -235,6 +348,10 @@ void ConfigParser::ParseServerBlock(ServerConfig *server_config)
     {
       ParseLocationBlockEntry(server_config);
     }
+    else if (IsTypesBlock())
+    {
+      ParseTypesBlock(server_config);
+    }
     else
     {
       HandleServerDirective(server_config);
@@ -338,7 +455,10 @@ void ConfigParser::ParseLocationDirectives(LocationConfig *location_config)
     if (IsBlockEnd())
       return;
 
-    HandleLocationDirective(location_config);
+    if (IsTypesBlock())
+      ParseTypesBlock(location_config);
+    else
+      HandleLocationDirective(location_config);
   }
 }
 
@@ -393,8 +513,30 @@ void ConfigParser::HandleLocationDirective(LocationConfig *location_config)
     ParseLocationRedirectDirective(directive.second, location_config);
   else if (directive.first == "cgi_pass")
     ParseCgiPassDirective(directive.second, location_config);
+  else if (directive.first == "fastcgi_pass")
+    ParseFastCgiPassDirective(directive.second, location_config);
+  else if (directive.first == "cgi_pool")
+    ParseCgiPoolDirective(directive.second, location_config);
+  else if (directive.first == "cgi_cache")
+    ParseCgiCacheDirective(directive.second, location_config);
+  else if (directive.first == "cgi_cache_lock")
+    location_config->SetCgiCacheLock(ParseFlagDirective(directive.first, directive.second));
+  else if (directive.first == "cgi_cache_lock_timeout")
+    ParseCgiCacheLockTimeoutDirective(directive.second, location_config);
+  else if (directive.first == "cgi_max_concurrency")
+    location_config->SetCgiMaxConcurrency(ParseCountDirective(directive.first, directive.second));
+  else if (directive.first == "cgi_queue_size")
+    location_config->SetCgiQueueSize(ParseCountDirective(directive.first, directive.second));
+  else if (directive.first == "cgi_queue_timeout")
+    ParseCgiQueueTimeoutDirective(directive.second, location_config);
   else if (directive.first == "cgi_read_timeout")
     ParseCgiReadTimeoutDirective(directive.second, location_config);
+  else if (directive.first == "internal")
+  {
+    if (!directive.second.empty())
+      throw std::runtime_error("invalid number of arguments in \"internal\" directive");
+    location_config->SetInternal(true);
+  }
   else if (directive.first == "upload_path")
   {
     std::string path = parsing_utils::GetNextToken(directive.second);
@@ -418,6 +560,30 @@ void ConfigParser::HandleCommonDirective(const Directive &directive, BaseConfig
     ParseAutoIndexDirective(directive.second, config);
   else if (directive.first == "index")
     ParseIndexDirective(directive.second, config);
+  else if (directive.first == "autoindex_format")
+    ParseAutoIndexFormatDirective(directive.second, config);
+  else if (directive.first == "autoindex_page_size")
+    ParseAutoIndexPageSizeDirective(directive.second, config);
+  else if (directive.first == "open_file_cache")
+    ParseOpenFileCacheDirective(directive.second, config);
+  else if (directive.first == "open_file_cache_valid")
+    ParseOpenFileCacheValidDirective(directive.second, config);
+  else if (directive.first == "open_file_cache_errors")
+    ParseOpenFileCacheErrorsDirective(directive.second, config);
+  else if (directive.first == "static_cache")
+    ParseStaticCacheDirective(directive.second, config);
+  else if (directive.first == "gzip")
+    config->SetGzip(ParseFlagDirective(directive.first, directive.second));
+  else if (directive.first == "gzip_types")
+    ParseGzipTypesDirective(directive.second, config);
+  else if (directive.first == "gzip_min_length")
+    ParseGzipMinLengthDirective(directive.second, config);
+  else if (directive.first == "gzip_static")
+    config->SetGzipStatic(ParseFlagDirective(directive.first, directive.second));
+  else if (directive.first == "limit_rate")
+    config->SetLimitRate(ParseSingleSizeDirective(directive.first, directive.second));
+  else if (directive.first == "limit_rate_after")
+    config->SetLimitRateAfter(ParseSingleSizeDirective(directive.first, directive.second));
   else if (directive.first[0] != '#')
     throw std::runtime_error("unknown directive: " + directive.first);
 }
@@ -554,6 +720,175 @@ void ConfigParser::ParseIndexDirective(const std::string &value, BaseConfig *con
     throw std::runtime_error("invalid number of arguments in \"index\" directive");
 }
 
+void ConfigParser::ParseAutoIndexFormatDirective(const std::string &value, BaseConfig *config)
+{
+  if (value != "html" && value != "json")
+    throw std::runtime_error("invalid value \"" + value + "\" in \"autoindex_format\" directive, it must be \"html\" or \"json\"");
+  config->SetAutoindexFormat(value);
+}
+
+void ConfigParser::ParseAutoIndexPageSizeDirective(const std::string &value, BaseConfig *config)
+{
+  std::size_t page_size = 0;
+  std::istringstream iss(value);
+  if (value.empty() || !IsDigitsOnly(value) || !(iss >> page_size))
+    throw std::runtime_error("invalid value \"" + value + "\" in \"autoindex_page_size\" directive");
+  config->SetAutoindexPageSize(page_size);
+}
+
+void ConfigParser::ParseOpenFileCacheDirective(const std::string &value, BaseConfig *config)
+{
+  std::string remaining = value;
+  std::string token = parsing_utils::GetNextToken(remaining);
+
+  if (token.empty())
+    throw std::runtime_error("invalid number of arguments in \"open_file_cache\" directive");
+
+  if (token == "off")
+  {
+    if (!parsing_utils::GetNextToken(remaining).empty())
+      throw std::runtime_error("invalid number of arguments in \"open_file_cache\" directive");
+    config->SetOpenFileCache(0, config->GetOpenFileCacheInactive());
+    return;
+  }
+
+  std::size_t max = 0;
+  time_t inactive = 60000;
+  do
+  {
+    if (token.compare(0, 4, "max=") == 0)
+    {
+      std::string number_str = token.substr(4);
+      std::istringstream iss(number_str);
+      if (number_str.empty() || !IsDigitsOnly(number_str) || !(iss >> max) || max == 0)
+        throw std::runtime_error("invalid \"open_file_cache\" parameter \"" + token + "\"");
+    }
+    else if (token.compare(0, 9, "inactive=") == 0)
+    {
+      inactive = ParseTimeout(token.substr(9));
+    }
+    else
+    {
+      throw std::runtime_error("invalid \"open_file_cache\" parameter \"" + token + "\"");
+    }
+  } while (!(token = parsing_utils::GetNextToken(remaining)).empty());
+
+  if (max == 0)
+    throw std::runtime_error("\"open_file_cache\" must have the \"max\" parameter");
+
+  config->SetOpenFileCache(max, inactive);
+}
+
+void ConfigParser::ParseOpenFileCacheValidDirective(const std::string &value, BaseConfig *config)
+{
+  std::string remaining = value;
+  std::string valid_str = parsing_utils::GetNextToken(remaining);
+  if (valid_str.empty() || !parsing_utils::GetNextToken(remaining).empty())
+    throw std::runtime_error("invalid number of arguments in \"open_file_cache_valid\" directive");
+
+  config->SetOpenFileCacheValid(ParseTimeout(valid_str));
+}
+
+void ConfigParser::ParseOpenFileCacheErrorsDirective(const std::string &value, BaseConfig *config)
+{
+  config->SetOpenFileCacheErrors(ParseFlagDirective("open_file_cache_errors", value));
+}
+
+void ConfigParser::ParseStaticCacheDirective(const std::string &value, BaseConfig *config)
+{
+  std::string remaining = value;
+  std::string token = parsing_utils::GetNextToken(remaining);
+
+  if (token.empty())
+    throw std::runtime_error("invalid number of arguments in \"static_cache\" directive");
+
+  if (token == "off")
+  {
+    if (!parsing_utils::GetNextToken(remaining).empty())
+      throw std::runtime_error("invalid number of arguments in \"static_cache\" directive");
+    config->SetStaticCache(0, config->GetStaticCacheMaxFile());
+    return;
+  }
+
+  off_t max_size = 0;
+  off_t max_file = config->GetStaticCacheMaxFile();
+  do
+  {
+    if (token.compare(0, 9, "max_size=") == 0)
+      max_size = ParseSizeParameter("static_cache", token.substr(9));
+    else if (token.compare(0, 9, "max_file=") == 0)
+      max_file = ParseSizeParameter("static_cache", token.substr(9));
+    else
+      throw std::runtime_error("invalid \"static_cache\" parameter \"" + token + "\"");
+  } while (!(token = parsing_utils::GetNextToken(remaining)).empty());
+
+  if (max_size == 0)
+    throw std::runtime_error("\"static_cache\" must have the \"max_size\" parameter");
+
+  config->SetStaticCache(max_size, max_file);
+}
+
+off_t ConfigParser::ParseSizeParameter(const std::string &directive, const std::string &token)
+{
+  std::string number_str = token;
+  off_t multiplier = 1;
+
+  if (!token.empty())
+    ExtractSizeAndMultiplier(token, number_str, multiplier);
+  if (number_str.empty() || !IsDigitsOnly(number_str))
+    throw std::runtime_error("invalid size \"" + token + "\" in \"" + directive + "\" directive");
+  return ParseSizeValue(number_str, multiplier);
+}
+
+std::size_t ConfigParser::ParseCountDirective(const std::string &directive, const std::string &value)
+{
+  std::size_t count = 0;
+  std::istringstream iss(value);
+  if (value.empty() || !IsDigitsOnly(value) || !(iss >> count))
+    throw std::runtime_error("invalid value \"" + value + "\" in \"" + directive + "\" directive");
+  return count;
+}
+
+bool ConfigParser::ParseFlagDirective(const std::string &directive, const std::string &value)
+{
+  if (value != "on" && value != "off")
+    throw std::runtime_error("invalid value \"" + value + "\" in \"" + directive + "\" directive, it must be \"on\" or \"off\"");
+  return value == "on";
+}
+
+void ConfigParser::ParseGzipTypesDirective(const std::string &value, BaseConfig *config)
+{
+  std::string remaining = value;
+  std::vector<std::string> types;
+  std::string token;
+
+  while (!(token = parsing_utils::GetNextToken(remaining)).empty())
+  {
+    if (token != "*" && token.find('/') == std::string::npos)
+      throw std::runtime_error("invalid MIME type \"" + token + "\" in \"gzip_types\" directive");
+    types.push_back(libft::FT_ToLower(token));
+  }
+
+  if (types.empty())
+    throw std::runtime_error("invalid number of arguments in \"gzip_types\" directive");
+  config->SetGzipTypes(types);
+}
+
+void ConfigParser::ParseGzipMinLengthDirective(const std::string &value, BaseConfig *config)
+{
+  config->SetGzipMinLength(ParseSingleSizeDirective("gzip_min_length", value));
+}
+
+std::size_t ConfigParser::ParseSingleSizeDirective(const std::string &directive, const std::string &value)
+{
+  std::string remaining = value;
+  std::string size_str = parsing_utils::GetNextToken(remaining);
+  if (size_str.empty() || !parsing_utils::GetNextToken(remaining).empty())
+    throw std::runtime_error("invalid number of arguments in \"" + directive + "\" directive");
+
+  return ParseSizeParameter(directive, size_str);
+}
+
 void ConfigParser::ParseKeepaliveTimeoutDirective(const std::string &value,
                                                   BaseConfig *config)
 {
@@ -1221,6 +1556,137 @@ void ConfigParser::ParseCgiPassDirective(const std::string &value, LocationConfi
   location->AddCgiExecutor(extension, executor);
 }
 
+void ConfigParser::ParseFastCgiPassDirective(const std::string &value, LocationConfig *location)
+{
+  std::string remaining = value;
+  std::string address = parsing_utils::GetNextToken(remaining);
+  std::string extra = parsing_utils::GetNextToken(remaining);
+
+  if (address.empty() || !extra.empty())
+  {
+    throw std::runtime_error("invalid number of arguments in \"fastcgi_pass\" directive");
+  }
+
+  if (address.compare(0, 5, "unix:") == 0)
+  {
+    if (address.length() == 5 || address.length() - 5 >= sizeof(((struct sockaddr_un *)0)->sun_path))
+    {
+      throw std::runtime_error("invalid address \"" + address + "\" in \"fastcgi_pass\" directive");
+    }
+  }
+  else
+  {
+    std::string::size_type colon_pos = address.rfind(':');
+    std::string port;
+    if (colon_pos != std::string::npos && colon_pos > 0)
+    {
+      port = address.substr(colon_pos + 1);
+    }
+    if (port.empty() || port.length() > 5 || !IsDigitsOnly(port) ||
+        std::atoi(port.c_str()) < 1 || std::atoi(port.c_str()) > 65535)
+    {
+      throw std::runtime_error("invalid address \"" + address + "\" in \"fastcgi_pass\" directive");
+    }
+  }
+
+  location->SetFastCgiPass(address);
+}
+
+void ConfigParser::ParseCgiPoolDirective(const std::string &value, LocationConfig *location)
+{
+  std::string remaining = value;
+  std::string token = parsing_utils::GetNextToken(remaining);
+
+  if (token.empty())
+    throw std::runtime_error("invalid number of arguments in \"cgi_pool\" directive");
+
+  if (token == "off")
+  {
+    if (!parsing_utils::GetNextToken(remaining).empty())
+      throw std::runtime_error("invalid number of arguments in \"cgi_pool\" directive");
+    location->SetCgiPool(0, 0);
+    return;
+  }
+
+  std::size_t size = 0;
+  std::istringstream size_stream(token);
+  if (!IsDigitsOnly(token) || !(size_stream >> size) || size == 0 || size > 256)
+    throw std::runtime_error("invalid value \"" + token + "\" in \"cgi_pool\" directive");
+
+  std::size_t queue = 0;
+  while (!(token = parsing_utils::GetNextToken(remaining)).empty())
+  {
+    std::string number_str = token.substr(std::min(token.size(), static_cast<std::size_t>(6)));
+    std::istringstream iss(number_str);
+    if (token.compare(0, 6, "queue=") != 0 || number_str.empty() ||
+        !IsDigitsOnly(number_str) || !(iss >> queue) || queue == 0)
+      throw std::runtime_error("invalid \"cgi_pool\" parameter \"" + token + "\"");
+  }
+
+  location->SetCgiPool(size, queue);
+}
+
+void ConfigParser::ParseCgiCacheDirective(const std::string &value, LocationConfig *location)
+{
+  std::string remaining = value;
+  std::string token = parsing_utils::GetNextToken(remaining);
+
+  if (token.empty())
+    throw std::runtime_error("invalid number of arguments in \"cgi_cache\" directive");
+
+  if (token == "off")
+  {
+    if (!parsing_utils::GetNextToken(remaining).empty())
+      throw std::runtime_error("invalid number of arguments in \"cgi_cache\" directive");
+    location->SetCgiCache(0, 0, 0);
+    return;
+  }
+
+  off_t max_size = 0;
+  time_t valid = 0;
+  time_t stale = 0;
+  do
+  {
+    if (token.compare(0, 9, "max_size=") == 0)
+      max_size = ParseSizeParameter("cgi_cache", token.substr(9));
+    else if (token.compare(0, 6, "valid=") == 0 && token.size() > 6)
+      valid = ParseTimeout(token.substr(6));
+    else if (token.compare(0, 6, "stale=") == 0 && token.size() > 6)
+      stale = ParseTimeout(token.substr(6));
+    else
+      throw std::runtime_error("invalid \"cgi_cache\" parameter \"" + token + "\"");
+  } while (!(token = parsing_utils::GetNextToken(remaining)).empty());
+
+  if (max_size == 0)
+    throw std::runtime_error("\"cgi_cache\" must have the \"max_size\" parameter");
+
+  location->SetCgiCache(max_size, valid, stale);
+}
+
+void ConfigParser::ParseCgiCacheLockTimeoutDirective(const std::string &value, LocationConfig *location)
+{
+  std::string remaining = value;
+  remaining = parsing_utils::ExtractQuotedString(remaining);
+  if (remaining.empty())
+  {
+    throw std::runtime_error("invalid number of arguments in \"cgi_cache_lock_timeout\" directive");
+  }
+
+  location->SetCgiCacheLockTimeout(ParseTimeout(remaining));
+}
+
+void ConfigParser::ParseCgiQueueTimeoutDirective(const std::string &value, LocationConfig *location)
+{
+  std::string remaining = value;
+  remaining = parsing_utils::ExtractQuotedString(remaining);
+  if (remaining.empty())
+  {
+    throw std::runtime_error("invalid number of arguments in \"cgi_queue_timeout\" directive");
+  }
+
+  location->SetCgiQueueTimeout(ParseTimeout(remaining));
+}
+
 void ConfigParser::ParseCgiReadTimeoutDirective(const std::string &value, LocationConfig *location)
 {
   std::string remaining = value;
@@ -8,6 +8,7 @@ HttpConfig::HttpConfig(const HttpConfig& other) : BaseConfig(other), keepalive_t
     for (std::vector<ServerConfig*>::const_iterator it = other.servers_.begin();
          it != other.servers_.end(); ++it) {
         servers_.push_back(new ServerConfig(**it));
+        vhost_index_.Add(servers_.back());
     }
     autoindex_set_ = false;
     keepalive_timeout_set_ = false;
@@ -28,9 +29,11 @@ HttpConfig& HttpConfig::operator=(const HttpConfig& other) {
             delete *it;
         }
         servers_.clear();
+        vhost_index_.Clear();
         for (std::vector<ServerConfig*>::const_iterator it = other.servers_.begin();
              it != other.servers_.end(); ++it) {
             servers_.push_back(new ServerConfig(**it));
+            vhost_index_.Add(servers_.back());
         }
         keepalive_timeout_ = other.keepalive_timeout_;
         keepalive_timeout_set_ = other.keepalive_timeout_set_;
@@ -50,6 +53,11 @@ void HttpConfig::AddServer(ServerConfig* server) {
         return;
     }
     servers_.push_back(server);
+    vhost_index_.Add(server);
+}
+
+ServerConfig* HttpConfig::FindServer(const char* host, std::size_t length, int port) const {
+    return vhost_index_.Find(host, length, port);
 }
 
 time_t HttpConfig::GetKeepaliveTimeout() const {
@@ -5,9 +5,20 @@ LocationConfig::LocationConfig()
     : path_(""),
       redirect_("", -1),
       script_filename_(""),
+      cgi_pool_size_(0),
+      cgi_pool_queue_(0),
+      cgi_cache_max_size_(0),
+      cgi_cache_valid_(0),
+      cgi_cache_stale_(0),
+      cgi_cache_lock_(false),
+      cgi_cache_lock_timeout_(5000),
+      cgi_max_concurrency_(0),
+      cgi_queue_size_(0),
+      cgi_queue_timeout_(10000),
       cgi_read_timeout_(60000),
       keepalive_timeout_(-1),
-      keepalive_timeout_set_(false)
+      keepalive_timeout_set_(false),
+      internal_(false)
 {
     accepted_methods_.push_back("GET");
     accepted_methods_.push_back("POST");
@@ -21,10 +32,22 @@ LocationConfig::LocationConfig(const LocationConfig &other)
       redirect_(other.redirect_),
       script_filename_(other.script_filename_),
       cgi_executors_(other.cgi_executors_),
+      fastcgi_pass_(other.fastcgi_pass_),
+      cgi_pool_size_(other.cgi_pool_size_),
+      cgi_pool_queue_(other.cgi_pool_queue_),
+      cgi_cache_max_size_(other.cgi_cache_max_size_),
+      cgi_cache_valid_(other.cgi_cache_valid_),
+      cgi_cache_stale_(other.cgi_cache_stale_),
+      cgi_cache_lock_(other.cgi_cache_lock_),
+      cgi_cache_lock_timeout_(other.cgi_cache_lock_timeout_),
+      cgi_max_concurrency_(other.cgi_max_concurrency_),
+      cgi_queue_size_(other.cgi_queue_size_),
+      cgi_queue_timeout_(other.cgi_queue_timeout_),
       cgi_read_timeout_(other.cgi_read_timeout_),
       upload_path_(other.upload_path_),
       keepalive_timeout_(other.keepalive_timeout_),
-      keepalive_timeout_set_(other.keepalive_timeout_set_)
+      keepalive_timeout_set_(other.keepalive_timeout_set_),
+      internal_(other.internal_)
 {
 }
 
@@ -33,14 +56,26 @@ LocationConfig::LocationConfig(ServerConfig *server_config)
       path_(""),
       redirect_(server_config->GetRedirect()),
       script_filename_(""),
+      cgi_pool_size_(0),
+      cgi_pool_queue_(0),
+      cgi_cache_max_size_(0),
+      cgi_cache_valid_(0),
+      cgi_cache_stale_(0),
+      cgi_cache_lock_(false),
+      cgi_cache_lock_timeout_(5000),
+      cgi_max_concurrency_(0),
+      cgi_queue_size_(0),
+      cgi_queue_timeout_(10000),
       cgi_read_timeout_(60000),
       keepalive_timeout_(server_config->GetKeepaliveTimeout()),
-      keepalive_timeout_set_(false)
+      keepalive_timeout_set_(false),
+      internal_(false)
 {
     accepted_methods_.push_back("GET");
     accepted_methods_.push_back("POST");
     accepted_methods_.push_back("DELETE");
     autoindex_set_ = false;
+    types_set_ = false;
 }
 
 LocationConfig::~LocationConfig() {}
@@ -101,6 +136,104 @@ std::string LocationConfig::GetCgiExecutor(const std::string &extension) const
     return "";
 }
 
+void LocationConfig::SetFastCgiPass(const std::string &address)
+{
+    fastcgi_pass_ = address;
+}
+
+const std::string &LocationConfig::GetFastCgiPass() const
+{
+    return fastcgi_pass_;
+}
+
+void LocationConfig::SetCgiPool(std::size_t size, std::size_t queue)
+{
+    cgi_pool_size_ = size;
+    cgi_pool_queue_ = queue;
+}
+
+std::size_t LocationConfig::GetCgiPoolSize() const
+{
+    return cgi_pool_size_;
+}
+
+std::size_t LocationConfig::GetCgiPoolQueue() const
+{
+    return cgi_pool_queue_;
+}
+
+void LocationConfig::SetCgiCache(std::size_t max_size, time_t valid, time_t stale)
+{
+    cgi_cache_max_size_ = max_size;
+    cgi_cache_valid_ = valid;
+    cgi_cache_stale_ = stale;
+}
+
+std::size_t LocationConfig::GetCgiCacheMaxSize() const
+{
+    return cgi_cache_max_size_;
+}
+
+time_t LocationConfig::GetCgiCacheValid() const
+{
+    return cgi_cache_valid_;
+}
+
+time_t LocationConfig::GetCgiCacheStale() const
+{
+    return cgi_cache_stale_;
+}
+
+void LocationConfig::SetCgiCacheLock(bool lock)
+{
+    cgi_cache_lock_ = lock;
+}
+
+bool LocationConfig::GetCgiCacheLock() const
+{
+    return cgi_cache_lock_;
+}
+
+void LocationConfig::SetCgiCacheLockTimeout(time_t timeout)
+{
+    cgi_cache_lock_timeout_ = timeout;
+}
+
+time_t LocationConfig::GetCgiCacheLockTimeout() const
+{
+    return cgi_cache_lock_timeout_;
+}
+
+void LocationConfig::SetCgiMaxConcurrency(std::size_t max)
+{
+    cgi_max_concurrency_ = max;
+}
+
+std::size_t LocationConfig::GetCgiMaxConcurrency() const
+{
+    return cgi_max_concurrency_;
+}
+
+void LocationConfig::SetCgiQueueSize(std::size_t size)
+{
+    cgi_queue_size_ = size;
+}
+
+std::size_t LocationConfig::GetCgiQueueSize() const
+{
+    return cgi_queue_size_;
+}
+
+void LocationConfig::SetCgiQueueTimeout(time_t timeout)
+{
+    cgi_queue_timeout_ = timeout;
+}
+
+time_t LocationConfig::GetCgiQueueTimeout() const
+{
+    return cgi_queue_timeout_;
+}
+
 void LocationConfig::SetScriptFilename(const std::string &filename)
 {
     script_filename_ = filename;
@@ -146,3 +279,13 @@ bool LocationConfig::IsKeepaliveTimeoutSet() const
 {
     return keepalive_timeout_set_;
 }
+
+void LocationConfig::SetInternal(bool internal)
+{
+    internal_ = internal;
+}
+
+bool LocationConfig::IsInternal() const
+{
+    return internal_;
+}
@@ -0,0 +1,102 @@
+#include "../../inc/Config/location_trie.h"
+
+LocationTrie::LocationTrie() : root_(new Node()) {
+}
+
+LocationTrie::LocationTrie(const LocationTrie& other) : root_(CopyNode(other.root_)) {
+}
+
+LocationTrie::~LocationTrie() {
+  DeleteNode(root_);
+}
+
+LocationTrie& LocationTrie::operator=(const LocationTrie& other) {
+  if (this != &other) {
+    Node* copy = CopyNode(other.root_);
+    DeleteNode(root_);
+    root_ = copy;
+  }
+  return *this;
+}
+
+LocationTrie::Node* LocationTrie::CopyNode(const Node* node) {
+  Node* copy = new Node();
+  copy->label = node->label;
+  copy->location = node->location;
+  try {
+    for (std::map<char, Node*>::const_iterator it = node->children.begin();
+         it != node->children.end(); ++it) {
+      copy->children[it->first] = CopyNode(it->second);
+    }
+  } catch (...) {
+    DeleteNode(copy);
+    throw;
+  }
+  return copy;
+}
+
+void LocationTrie::DeleteNode(Node* node) {
+  for (std::map<char, Node*>::iterator it = node->children.begin();
+       it != node->children.end(); ++it) {
+    DeleteNode(it->second);
+  }
+  delete node;
+}
+
+void LocationTrie::Insert(const std::string& prefix, const LocationConfig* location) {
+  Node* node = root_;
+  size_t pos = 0;
+
+  while (pos < prefix.size()) {
+    std::map<char, Node*>::iterator it = node->children.find(prefix[pos]);
+    if (it == node->children.end()) {
+      Node* leaf = new Node();
+      leaf->label = prefix.substr(pos);
+      leaf->location = location;
+      node->children[prefix[pos]] = leaf;
+      return;
+    }
+
+    Node* child = it->second;
+    size_t common = 0;
+    while (common < child->label.size() && pos + common < prefix.size() &&
+           child->label[common] == prefix[pos + common]) {
+      ++common;
+    }
+
+    if (common < child->label.size()) {
+      Node* split = new Node();
+      split->label = child->label.substr(0, common);
+      child->label.erase(0, common);
+      split->children[child->label[0]] = child;
+      it->second = split;
+      child = split;
+    }
+    node = child;
+    pos += common;
+  }
+  node->location = location;
+}
+
+const LocationConfig* LocationTrie::FindLongestPrefix(const std::string& path) const {
+  const Node* node = root_;
+  const LocationConfig* best = node->location;
+  size_t pos = 0;
+
+  while (pos < path.size()) {
+    std::map<char, Node*>::const_iterator it = node->children.find(path[pos]);
+    if (it == node->children.end()) {
+      break;
+    }
+    const Node* child = it->second;
+    if (path.compare(pos, child->label.size(), child->label) != 0) {
+      break;
+    }
+    node = child;
+    pos += child->label.size();
+    if (node->location) {
+      best = node->location;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,129 @@
+#include "../../inc/Config/mime_type_table.h"
+#include "../../inc/Util/libft.h"
+
+#include <cctype>
+
+namespace {
+
+char LowerChar(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+}  // namespace
+
+MimeTypeTable::MimeTypeTable() : block_(NULL) {
+}
+
+MimeTypeTable::MimeTypeTable(const MimeTypeTable& other) : block_(other.block_) {
+  if (block_) {
+    ++block_->refs;
+  }
+}
+
+MimeTypeTable::~MimeTypeTable() {
+  Release();
+}
+
+MimeTypeTable& MimeTypeTable::operator=(const MimeTypeTable& other) {
+  if (block_ != other.block_) {
+    Release();
+    block_ = other.block_;
+    if (block_) {
+      ++block_->refs;
+    }
+  }
+  return *this;
+}
+
+void MimeTypeTable::Release() {
+  if (block_ && --block_->refs == 0) {
+    delete block_;
+  }
+  block_ = NULL;
+}
+
+void MimeTypeTable::Reset() {
+  Release();
+  block_ = new Block();
+  block_->count = 0;
+  block_->refs = 1;
+}
+
+bool MimeTypeTable::Defined() const {
+  return block_ != NULL;
+}
+
+bool MimeTypeTable::Empty() const {
+  return !block_ || block_->count == 0;
+}
+
+std::size_t MimeTypeTable::Hash(const char* extension, std::size_t length) {
+  std::size_t hash = 2166136261u;
+  for (std::size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(LowerChar(extension[i]))) * 16777619u;
+  }
+  return hash;
+}
+
+void MimeTypeTable::Add(const std::string& extension, const std::string& type) {
+  if (!block_) {
+    Reset();
+  }
+  Insert(libft::FT_ToLower(extension), type);
+}
+
+void MimeTypeTable::Insert(const std::string& extension, const std::string& type) {
+  if ((block_->count + 1) * 4 > block_->slots.size() * 3) {
+    Grow();
+  }
+
+  std::size_t mask = block_->slots.size() - 1;
+  std::size_t index = Hash(extension.data(), extension.size()) & mask;
+  while (!block_->slots[index].extension.empty()) {
+    if (block_->slots[index].extension == extension) {
+      block_->slots[index].type = type;
+      return;
+    }
+    index = (index + 1) & mask;
+  }
+  block_->slots[index].extension = extension;
+  block_->slots[index].type = type;
+  ++block_->count;
+}
+
+void MimeTypeTable::Grow() {
+  std::vector<Entry> old_slots;
+  old_slots.swap(block_->slots);
+  block_->slots.resize(old_slots.empty() ? 64 : old_slots.size() * 2);
+  block_->count = 0;
+
+  for (std::vector<Entry>::const_iterator it = old_slots.begin();
+       it != old_slots.end(); ++it) {
+    if (!it->extension.empty()) {
+      Insert(it->extension, it->type);
+    }
+  }
+}
+
+const char* MimeTypeTable::Find(const char* extension, std::size_t length) const {
+  if (Empty() || length == 0) {
+    return NULL;
+  }
+
+  std::size_t mask = block_->slots.size() - 1;
+  std::size_t index = Hash(extension, length) & mask;
+  while (!block_->slots[index].extension.empty()) {
+    const Entry& entry = block_->slots[index];
+    if (entry.extension.size() == length) {
+      std::size_t i = 0;
+      while (i < length && LowerChar(extension[i]) == entry.extension[i]) {
+        ++i;
+      }
+      if (i == length) {
+        return entry.type.c_str();
+      }
+    }
+    index = (index + 1) & mask;
+  }
+  return NULL;
+}
@@ -1,17 +1,23 @@
 #include "../../inc/Config/server_config.h"
+#include "../../inc/Response/mime_type.h"
+
+#include <fstream>
+#include <iterator>
 
 ServerConfig::ServerConfig() : is_default_(false), keepalive_timeout_(-1), keepalive_timeout_set_(false), http_config_(NULL) {
 }
 
 ServerConfig::ServerConfig(const ServerConfig& other) : BaseConfig(other),
   locations_(other.locations_),
+  location_trie_(other.location_trie_),
   server_names_(other.server_names_),
   is_default_(other.is_default_),
   keepalive_timeout_(other.keepalive_timeout_),
   keepalive_timeout_set_(other.keepalive_timeout_set_),
   redirect_(other.redirect_),
   listen_directives_(other.listen_directives_),
-  http_config_(other.http_config_) {
+  http_config_(other.http_config_),
+  error_page_bodies_(other.error_page_bodies_) {
 }
 
 ServerConfig::ServerConfig(HttpConfig* http_config) : BaseConfig(*http_config),
@@ -20,6 +26,7 @@ ServerConfig::ServerConfig(HttpConfig* http_config) : BaseConfig(*http_config),
   keepalive_timeout_set_(false),
   http_config_(http_config) {
     autoindex_set_ = false;
+    types_set_ = false;
 }
 
 ServerConfig::~ServerConfig() {
@@ -39,6 +46,7 @@ ServerConfig& ServerConfig::operator=(const ServerConfig& other) {
     keepalive_timeout_set_ = other.keepalive_timeout_set_;
     redirect_ = other.redirect_;
     http_config_ = other.http_config_;
+    error_page_bodies_ = other.error_page_bodies_;
   }
   return *this;
 }
@@ -109,4 +117,44 @@ void ServerConfig::AddLocation(LocationConfig* location) {
     throw std::runtime_error(error_msg);
   }
   locations_[location->GetPath()] = location;
+  location_trie_.Insert(location->GetPath(), location);
+}
+
+const LocationConfig* ServerConfig::FindLocation(const std::string& path) const {
+  return location_trie_.FindLongestPrefix(path);
+}
+
+void ServerConfig::LoadErrorPages() {
+  error_page_bodies_.clear();
+
+  std::map<std::string, ErrorPageBody> loaded;
+  for (std::map<int, std::string>::const_iterator it = error_pages_.begin();
+       it != error_pages_.end(); ++it) {
+    std::map<std::string, ErrorPageBody>::iterator page = loaded.find(it->second);
+    if (page == loaded.end()) {
+      std::string file_path = root_;
+      if (!file_path.empty() && file_path[file_path.length() - 1] != '/') {
+        file_path += "/";
+      }
+      file_path += it->second;
+
+      std::ifstream file(file_path.c_str(), std::ios::in | std::ios::binary);
+      if (!file.is_open()) {
+        continue;
+      }
+      std::string content((std::istreambuf_iterator<char>(file)),
+                          std::istreambuf_iterator<char>());
+
+      ErrorPageBody body;
+      body.body = SharedBuffer::Adopt(content);
+      body.content_type = MimeType::ForPath(*this, it->second);
+      page = loaded.insert(std::make_pair(it->second, body)).first;
+    }
+    error_page_bodies_[it->first] = page->second;
+  }
+}
+
+const ErrorPageBody* ServerConfig::FindErrorPage(int code) const {
+  std::map<int, ErrorPageBody>::const_iterator it = error_page_bodies_.find(code);
+  return it != error_page_bodies_.end() ? &it->second : NULL;
 }
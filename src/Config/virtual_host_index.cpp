@@ -0,0 +1,249 @@
+#include "../../inc/Config/virtual_host_index.h"
+#include "../../inc/Config/server_config.h"
+#include "../../inc/Util/libft.h"
+
+#include <cctype>
+
+namespace {
+
+char LowerChar(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+}  // namespace
+
+VirtualHostIndex::VirtualHostIndex()
+    : name_count_(0), any_port_wildcards_(NULL), first_server_(NULL) {
+}
+
+VirtualHostIndex::~VirtualHostIndex() {
+  Clear();
+}
+
+void VirtualHostIndex::Clear() {
+  names_.clear();
+  name_count_ = 0;
+  for (std::map<int, PortEntry>::iterator it = ports_.begin(); it != ports_.end(); ++it) {
+    DeleteSuffixNode(it->second.wildcards);
+  }
+  ports_.clear();
+  DeleteSuffixNode(any_port_wildcards_);
+  any_port_wildcards_ = NULL;
+  first_server_ = NULL;
+}
+
+void VirtualHostIndex::Add(ServerConfig* server) {
+  if (!first_server_) {
+    first_server_ = server;
+  }
+
+  const std::vector<ListenDirective>& listens = server->GetListenDirectives();
+  for (std::vector<ListenDirective>::const_iterator it = listens.begin();
+       it != listens.end(); ++it) {
+    PortEntry& entry = ports_[it->port];
+    if (!entry.first_server) {
+      entry.first_server = server;
+    }
+    if (server->IsDefault() && !entry.default_server) {
+      entry.default_server = server;
+    }
+  }
+
+  const std::vector<std::string>& groups = server->GetServerNames();
+  for (std::vector<std::string>::const_iterator group = groups.begin();
+       group != groups.end(); ++group) {
+    std::string::size_type start = 0;
+    while (start < group->size()) {
+      std::string::size_type end = group->find(' ', start);
+      if (end == std::string::npos) {
+        end = group->size();
+      }
+      if (end > start) {
+        std::string name = libft::FT_ToLower(group->substr(start, end - start));
+        for (std::vector<ListenDirective>::const_iterator it = listens.begin();
+             it != listens.end(); ++it) {
+          AddName(it->port, name, server);
+        }
+        AddName(kAnyPort, name, server);
+      }
+      start = end + 1;
+    }
+  }
+}
+
+void VirtualHostIndex::AddName(int port, const std::string& name, ServerConfig* server) {
+  bool subdomain_only = name.size() > 2 && name[0] == '*' && name[1] == '.';
+  bool with_domain = name.size() > 1 && name[0] == '.';
+
+  if (!subdomain_only && !with_domain) {
+    InsertEntry(port, name, server);
+    return;
+  }
+
+  SuffixNode** root = &any_port_wildcards_;
+  if (port != kAnyPort) {
+    root = &ports_[port].wildcards;
+  }
+  AddWildcard(root, name.substr(subdomain_only ? 2 : 1), with_domain, server);
+}
+
+std::size_t VirtualHostIndex::Hash(int port, const char* name, std::size_t length) {
+  std::size_t hash = 2166136261u;
+  unsigned int key = static_cast<unsigned int>(port);
+  for (int i = 0; i < 4; ++i) {
+    hash = (hash ^ ((key >> (i * 8)) & 0xff)) * 16777619u;
+  }
+  for (std::size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(LowerChar(name[i]))) * 16777619u;
+  }
+  return hash;
+}
+
+void VirtualHostIndex::InsertEntry(int port, const std::string& name, ServerConfig* server) {
+  if ((name_count_ + 1) * 4 > names_.size() * 3) {
+    Grow();
+  }
+
+  std::size_t mask = names_.size() - 1;
+  std::size_t index = Hash(port, name.data(), name.size()) & mask;
+  while (names_[index].server) {
+    if (names_[index].port == port && names_[index].name == name) {
+      return;
+    }
+    index = (index + 1) & mask;
+  }
+  names_[index].port = port;
+  names_[index].name = name;
+  names_[index].server = server;
+  ++name_count_;
+}
+
+void VirtualHostIndex::Grow() {
+  std::vector<NameEntry> old_names;
+  old_names.swap(names_);
+  names_.resize(old_names.empty() ? 16 : old_names.size() * 2);
+  name_count_ = 0;
+
+  for (std::vector<NameEntry>::const_iterator it = old_names.begin();
+       it != old_names.end(); ++it) {
+    if (it->server) {
+      InsertEntry(it->port, it->name, it->server);
+    }
+  }
+}
+
+ServerConfig* VirtualHostIndex::FindName(int port, const char* host, std::size_t length) const {
+  if (names_.empty() || length == 0) {
+    return NULL;
+  }
+
+  std::size_t mask = names_.size() - 1;
+  std::size_t index = Hash(port, host, length) & mask;
+  while (names_[index].server) {
+    const NameEntry& entry = names_[index];
+    if (entry.port == port && entry.name.size() == length) {
+      std::size_t i = 0;
+      while (i < length && LowerChar(host[i]) == entry.name[i]) {
+        ++i;
+      }
+      if (i == length) {
+        return entry.server;
+      }
+    }
+    index = (index + 1) & mask;
+  }
+  return NULL;
+}
+
+void VirtualHostIndex::AddWildcard(SuffixNode** root, const std::string& suffix,
+                                   bool match_domain, ServerConfig* server) {
+  if (!*root) {
+    *root = new SuffixNode();
+  }
+
+  SuffixNode* node = *root;
+  for (std::string::size_type i = suffix.size(); i > 0; --i) {
+    SuffixNode*& child = node->children[suffix[i - 1]];
+    if (!child) {
+      child = new SuffixNode();
+    }
+    node = child;
+  }
+
+  if (!node->subdomain) {
+    node->subdomain = server;
+  }
+  if (match_domain && !node->domain) {
+    node->domain = server;
+  }
+}
+
+ServerConfig* VirtualHostIndex::FindWildcard(const SuffixNode* root,
+                                             const char* host, std::size_t length) {
+  ServerConfig* best = NULL;
+  const SuffixNode* node = root;
+
+  for (std::size_t start = length; node && start > 0; --start) {
+    std::map<char, SuffixNode*>::const_iterator it = node->children.find(LowerChar(host[start - 1]));
+    if (it == node->children.end()) {
+      break;
+    }
+    node = it->second;
+
+    std::size_t begin = start - 1;
+    if (begin == 0) {
+      if (node->domain) {
+        best = node->domain;
+      }
+    } else if (begin > 1 && host[begin - 1] == '.' && node->subdomain) {
+      best = node->subdomain;
+    }
+  }
+  return best;
+}
+
+void VirtualHostIndex::DeleteSuffixNode(SuffixNode* node) {
+  if (!node) {
+    return;
+  }
+  for (std::map<char, SuffixNode*>::iterator it = node->children.begin();
+       it != node->children.end(); ++it) {
+    DeleteSuffixNode(it->second);
+  }
+  delete node;
+}
+
+ServerConfig* VirtualHostIndex::Find(const char* host, std::size_t length, int port) const {
+  if (length > 0 && host[length - 1] == '.') {
+    --length;
+  }
+
+  ServerConfig* server = FindName(port, host, length);
+  if (server) {
+    return server;
+  }
+
+  std::map<int, PortEntry>::const_iterator it = ports_.find(port);
+  if (it != ports_.end()) {
+    const PortEntry& entry = it->second;
+    if (entry.wildcards && length > 0 &&
+        (server = FindWildcard(entry.wildcards, host, length))) {
+      return server;
+    }
+    if (entry.default_server) {
+      return entry.default_server;
+    }
+    if (entry.first_server) {
+      return entry.first_server;
+    }
+  }
+
+  if ((server = FindName(kAnyPort, host, length))) {
+    return server;
+  }
+  if (any_port_wildcards_ && length > 0 &&
+      (server = FindWildcard(any_port_wildcards_, host, length))) {
+    return server;
+  }
+  return first_server_;
+}
@@ -73,6 +73,11 @@ PreconditionFailedException::PreconditionFailedException()
 
 PreconditionFailedException::~PreconditionFailedException() throw() {}
 
+RangeNotSatisfiableException::RangeNotSatisfiableException()
+    : HttpException(416, "Range Not Satisfiable") {}
+
+RangeNotSatisfiableException::~RangeNotSatisfiableException() throw() {}
+
 MisdirectedRequestException::MisdirectedRequestException()
     : HttpException(421, "Misdirected Request") {}
 
@@ -11,7 +11,9 @@ HttpRequest::HttpRequest()
       content_type_(""),
       boundary_(""),
       is_chunked_(false),
-      port_(-1) {}
+      port_(-1),
+      location_(NULL),
+      internal_(false) {}
 
 HttpRequest::~HttpRequest() {}
 
@@ -96,6 +98,18 @@ int HttpRequest::GetPort() const { return port_; }
 
 void HttpRequest::SetPort(int port) { port_ = port; }
 
+const LocationConfig* HttpRequest::GetLocation() const { return location_; }
+
+void HttpRequest::SetLocation(const LocationConfig* location) {
+  location_ = location;
+}
+
+void HttpRequest::SetInternal(bool internal) {
+  internal_ = internal;
+}
+
+bool HttpRequest::IsInternal() const { return internal_; }
+
 void HttpRequest::Reset() {
   method_ = "";
   path_ = "";
@@ -110,4 +124,6 @@ void HttpRequest::Reset() {
   boundary_ = "";
   is_chunked_ = false;
   port_ = -1;
+  location_ = NULL;
+  internal_ = false;
 }
@@ -126,6 +126,7 @@ bool RequestParser::ParseStartLine() {
   buffer_.erase(0, pos + 2);
 
   ParseUri(uri);
+  request_.SetLocation(FindMatchingLocation(request_, config_));
 
   request_.SetMethod(method);
   request_.SetVersion(version);
@@ -189,12 +190,15 @@ void RequestParser::ParseUri(std::string &uri) {
     ExtractHostFromAbsoluteUri(uri);
   }
 
-  uri = parsing_utils::UrlDecode(uri);
+  if (uri.empty() || uri[0] != '/') {
+    throw BadRequestException();
+  }
+
   SetPathAndQueryString(uri);
 }
 
 bool RequestParser::IsAbsoluteUri(const std::string &uri) {
-  return uri.substr(0, 7) == "http://";
+  return uri.compare(0, 7, "http://") == 0;
 }
 
 void RequestParser::ExtractHostFromAbsoluteUri(std::string &uri) {
@@ -211,14 +215,15 @@ void RequestParser::ExtractHostFromAbsoluteUri(std::string &uri) {
 
 void RequestParser::SetPathAndQueryString(const std::string &uri) {
   std::string::size_type query_pos = uri.find('?');
-  if (query_pos != std::string::npos) {
-    std::string path = uri.substr(0, query_pos);
-    std::string query = uri.substr(query_pos + 1);
+  std::string path;
 
-    request_.SetPath(path);
-    request_.SetQueryString(query);
-  } else {
-    request_.SetPath(uri);
+  if (!parsing_utils::NormalizePath(uri.substr(0, query_pos), true, path)) {
+    throw BadRequestException();
+  }
+  request_.SetPath(path);
+
+  if (query_pos != std::string::npos) {
+    request_.SetQueryString(parsing_utils::UrlDecode(uri.substr(query_pos + 1)));
   }
 }
 
@@ -535,11 +540,9 @@ bool RequestParser::ParseBody() {
 }
 
 void RequestParser::CheckBodySize(std::size_t received_so_far) {
-  if (config_) {
-    const LocationConfig* location = FindMatchingLocation(request_, config_);
-    if (location && received_so_far + buffer_.length() > location->GetClientMaxBodySize()) {
-      throw ContentTooLargeException();
-    }
+  const LocationConfig* location = request_.GetLocation();
+  if (location && received_so_far + buffer_.length() > location->GetClientMaxBodySize()) {
+    throw ContentTooLargeException();
   }
 }
 
@@ -0,0 +1,340 @@
+#include "../../inc/Response/body_filter.h"
+
+#include <sys/time.h>
+#include <algorithm>
+#include <cstdlib>
+
+#include "../../inc/Response/gzip_filter.h"
+
+const off_t BodyPipeline::kSliceSize;
+const off_t BodyPipeline::kLowWatermark;
+
+BodyFilter::BodyFilter() : next_(NULL) {
+}
+
+BodyFilter::~BodyFilter() {
+}
+
+void BodyFilter::SetNext(BodyFilter* next) {
+  next_ = next;
+}
+
+void BodyFilter::Finish() {
+  if (next_) {
+    next_->Finish();
+  }
+}
+
+bool BodyFilter::Failed() const {
+  return false;
+}
+
+void BodyFilter::Forward(const BodySegment& segment) {
+  if (next_ && segment.length > 0) {
+    next_->Write(segment);
+  }
+}
+
+void BodyFilter::Forward(const SharedBuffer& data) {
+  BodySegment segment;
+  segment.data = data;
+  segment.offset = 0;
+  segment.length = data.Size();
+  Forward(segment);
+}
+
+RangeFilter::RangeFilter(off_t offset, off_t length)
+    : position_(0), start_(offset), end_(offset + length) {
+}
+
+void RangeFilter::Write(const BodySegment& segment) {
+  off_t segment_start = position_;
+  position_ += segment.length;
+
+  off_t from = std::max(segment_start, start_);
+  off_t to = std::min(position_, end_);
+  if (from >= to) {
+    return;
+  }
+
+  BodySegment slice = segment;
+  slice.offset += from - segment_start;
+  slice.length = to - from;
+  Forward(slice);
+}
+
+void ChunkedFilter::Write(const BodySegment& segment) {
+  static const char kHex[] = "0123456789abcdef";
+
+  char size_line[24];
+  std::size_t pos = sizeof(size_line);
+  size_line[--pos] = '\n';
+  size_line[--pos] = '\r';
+  off_t length = segment.length;
+  do {
+    size_line[--pos] = kHex[length & 0xf];
+    length >>= 4;
+  } while (length > 0);
+
+  Forward(SharedBuffer(std::string(size_line + pos, sizeof(size_line) - pos)));
+  Forward(segment);
+
+  static const SharedBuffer kCrlf("\r\n");
+  Forward(kCrlf);
+}
+
+void ChunkedFilter::Finish() {
+  static const SharedBuffer kLastChunk("0\r\n\r\n");
+  Forward(kLastChunk);
+  BodyFilter::Finish();
+}
+
+CountingFilter::CountingFilter(off_t expected)
+    : expected_(expected), count_(0), failed_(false) {
+}
+
+void CountingFilter::Write(const BodySegment& segment) {
+  count_ += segment.length;
+  Forward(segment);
+}
+
+void CountingFilter::Finish() {
+  if (expected_ >= 0 && count_ != expected_) {
+    failed_ = true;
+  }
+  BodyFilter::Finish();
+}
+
+bool CountingFilter::Failed() const {
+  return failed_;
+}
+
+off_t CountingFilter::Count() const {
+  return count_;
+}
+
+QueueFilter::QueueFilter(OutputQueue* output) : output_(output) {
+}
+
+void QueueFilter::Write(const BodySegment& segment) {
+  if (segment.file.Valid()) {
+    output_->Push(segment.file, segment.offset, segment.length);
+  } else {
+    output_->Push(segment.data, static_cast<std::size_t>(segment.offset),
+                  static_cast<std::size_t>(segment.length));
+  }
+}
+
+BodyPipeline::BodyPipeline()
+    : index_(0), counter_(NULL), output_(NULL), sliced_(false), done_(true),
+      streaming_(false), buffered_(0), rate_(0), rate_after_(0), fed_(0), started_ms_(0) {
+}
+
+BodyPipeline::~BodyPipeline() {
+  Reset();
+}
+
+void BodyPipeline::Start(const HttpResponse& response, const BaseConfig* config,
+                         OutputQueue* output, bool streaming) {
+  Reset();
+  output_ = output;
+  done_ = false;
+  streaming_ = streaming;
+
+  BodySegment body;
+  body.data = response.GetBodyBuffer();
+  body.offset = 0;
+  body.length = body.data.Size();
+  AddSource(body);
+  const std::vector<BodySegment>& segments = response.GetBodySegments();
+  for (std::vector<BodySegment>::const_iterator it = segments.begin();
+       it != segments.end(); ++it) {
+    AddSource(*it);
+  }
+
+  if (response.HasBodyRange()) {
+    AddFilter(new RangeFilter(response.GetBodyRangeOffset(), response.GetBodyLength()));
+  }
+  if (response.GetCompressBody()) {
+    AddFilter(new GzipBodyFilter());
+    sliced_ = true;
+  }
+
+  off_t expected = -1;
+  if (response.GetHeader("Transfer-Encoding") == "chunked") {
+    AddFilter(new ChunkedFilter());
+  } else if (streaming) {
+    const std::string& length = response.GetHeader("Content-Length");
+    expected = length.empty() ? -1 : std::atol(length.c_str());
+  } else if (!response.GetCompressBody()) {
+    expected = response.GetBodyLength();
+  }
+  counter_ = new CountingFilter(expected);
+  AddFilter(counter_);
+  AddFilter(new QueueFilter(output));
+
+  if (config && config->GetLimitRate() > 0) {
+    rate_ = config->GetLimitRate();
+    rate_after_ = config->GetLimitRateAfter();
+    started_ms_ = NowMs();
+    sliced_ = true;
+  }
+
+  Pump();
+}
+
+void BodyPipeline::Append(const SharedBuffer& data) {
+  if (!streaming_ || data.Empty()) {
+    return;
+  }
+  BodySegment segment;
+  segment.data = data;
+  segment.offset = 0;
+  segment.length = data.Size();
+  AddSource(segment);
+  Pump();
+}
+
+void BodyPipeline::End() {
+  if (streaming_) {
+    streaming_ = false;
+    Feed(0);
+    Pump();
+  }
+}
+
+// Moves body bytes into the output queue. Unsliced bodies go in at once
+// since every stage passes segments through by reference; sliced ones stop
+// at the low watermark or when the rate limit runs out.
+void BodyPipeline::Pump() {
+  if (done_) {
+    return;
+  }
+  if (!sliced_) {
+    Feed(-1);
+    return;
+  }
+
+  while (!done_ && !Starved() && output_->Pending() < kLowWatermark) {
+    off_t allowance = Allowance();
+    if (allowance <= 0) {
+      return;
+    }
+    Feed(std::min(allowance, static_cast<off_t>(kSliceSize)));
+  }
+}
+
+void BodyPipeline::Feed(off_t limit) {
+  while (index_ < source_.size() && limit != 0) {
+    BodySegment& segment = source_[index_];
+    BodySegment piece = segment;
+    if (limit > 0 && piece.length > limit) {
+      piece.length = limit;
+    }
+
+    filters_.front()->Write(piece);
+    fed_ += piece.length;
+    if (limit > 0) {
+      limit -= piece.length;
+    }
+
+    segment.offset += piece.length;
+    segment.length -= piece.length;
+    buffered_ -= piece.length;
+    if (segment.length == 0) {
+      source_[index_] = BodySegment();
+      ++index_;
+    }
+  }
+
+  if (index_ == source_.size()) {
+    source_.clear();
+    index_ = 0;
+    if (!streaming_) {
+      filters_.front()->Finish();
+      done_ = true;
+    }
+  }
+}
+
+off_t BodyPipeline::Allowance() const {
+  if (rate_ == 0) {
+    return kSliceSize;
+  }
+  off_t allowed = rate_after_ + rate_ * (NowMs() - started_ms_) / 1000;
+  return allowed - fed_;
+}
+
+void BodyPipeline::Reset() {
+  for (std::vector<BodyFilter*>::iterator it = filters_.begin();
+       it != filters_.end(); ++it) {
+    delete *it;
+  }
+  filters_.clear();
+  source_.clear();
+  index_ = 0;
+  counter_ = NULL;
+  output_ = NULL;
+  sliced_ = false;
+  done_ = true;
+  streaming_ = false;
+  buffered_ = 0;
+  rate_ = 0;
+  rate_after_ = 0;
+  fed_ = 0;
+}
+
+bool BodyPipeline::Done() const {
+  return done_;
+}
+
+bool BodyPipeline::Streaming() const {
+  return streaming_;
+}
+
+// A streamed body that has sent everything it was given so far.
+bool BodyPipeline::Starved() const {
+  return streaming_ && index_ == source_.size();
+}
+
+bool BodyPipeline::Throttled() const {
+  return !done_ && rate_ > 0 && Allowance() <= 0;
+}
+
+bool BodyPipeline::Failed() const {
+  for (std::vector<BodyFilter*>::const_iterator it = filters_.begin();
+       it != filters_.end(); ++it) {
+    if ((*it)->Failed()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+off_t BodyPipeline::Buffered() const {
+  return buffered_;
+}
+
+off_t BodyPipeline::BytesSent() const {
+  return counter_ ? counter_->Count() : 0;
+}
+
+void BodyPipeline::AddFilter(BodyFilter* filter) {
+  if (!filters_.empty()) {
+    filters_.back()->SetNext(filter);
+  }
+  filters_.push_back(filter);
+}
+
+void BodyPipeline::AddSource(const BodySegment& segment) {
+  if (segment.length > 0) {
+    source_.push_back(segment);
+    buffered_ += segment.length;
+  }
+}
+
+time_t BodyPipeline::NowMs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
@@ -0,0 +1,287 @@
+#include "../../inc/Response/directory_listing.h"
+#include "../../inc/Util/libft.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+DirectoryListing::ChunkWriter::ChunkWriter(std::vector<SharedBuffer>* chunks)
+    : chunks_(chunks) {
+  buffer_.reserve(kChunkSize);
+}
+
+void DirectoryListing::ChunkWriter::Append(const std::string& data) {
+  Append(data.data(), data.size());
+}
+
+void DirectoryListing::ChunkWriter::Append(const char* data, std::size_t length) {
+  buffer_.append(data, length);
+  if (buffer_.size() >= kChunkSize) {
+    Flush();
+  }
+}
+
+void DirectoryListing::ChunkWriter::AppendNumber(off_t value, std::size_t width) {
+  char digits[32];
+  std::size_t pos = sizeof(digits);
+  bool negative = value < 0;
+  do {
+    off_t digit = value % 10;
+    digits[--pos] = static_cast<char>('0' + (negative ? -digit : digit));
+    value /= 10;
+  } while (value != 0);
+  if (negative) {
+    digits[--pos] = '-';
+  }
+  while (sizeof(digits) - pos < width && pos > 0) {
+    digits[--pos] = ' ';
+  }
+  Append(digits + pos, sizeof(digits) - pos);
+}
+
+void DirectoryListing::ChunkWriter::Flush() {
+  if (buffer_.empty()) {
+    return;
+  }
+  chunks_->push_back(SharedBuffer::Adopt(buffer_));
+  buffer_.clear();
+  buffer_.reserve(kChunkSize);
+}
+
+DirectoryListing::DirectoryListing() {}
+
+DirectoryListing::~DirectoryListing() {}
+
+DirectoryListing& DirectoryListing::Instance() {
+  static DirectoryListing instance;
+  return instance;
+}
+
+std::size_t DirectoryListing::Render(const std::string& path, const struct stat& st,
+                                     const std::string& request_path, Format format,
+                                     std::size_t page_size, std::size_t page,
+                                     std::vector<SharedBuffer>* chunks) {
+  Directory& directory = Load(path, st);
+
+  std::size_t total = directory.entries.size();
+  std::size_t page_count = 1;
+  if (page_size > 0 && total > page_size) {
+    page_count = (total + page_size - 1) / page_size;
+  }
+  if (page_size == 0) {
+    page = 1;
+  }
+  if (page == 0 || page > page_count) {
+    return 0;
+  }
+
+  std::ostringstream key_stream;
+  key_stream << format << ':' << page_size << ':' << page << ':' << request_path;
+  std::string key = key_stream.str();
+
+  std::map<std::string, std::vector<SharedBuffer> >::iterator cached = directory.pages.find(key);
+  if (cached == directory.pages.end()) {
+    if (directory.pages.size() >= kMaxPagesPerDirectory) {
+      directory.pages.clear();
+    }
+    std::vector<SharedBuffer>& rendered = directory.pages[key];
+    ChunkWriter writer(&rendered);
+    std::size_t first = page_size > 0 ? (page - 1) * page_size : 0;
+    std::size_t last = page_size > 0 ? std::min(total, first + page_size) : total;
+    if (format == kJson) {
+      RenderJson(directory, first, last, &writer);
+    } else {
+      RenderHtml(directory, request_path, first, last, page, page_count, &writer);
+    }
+    writer.Flush();
+    cached = directory.pages.find(key);
+  }
+
+  chunks->insert(chunks->end(), cached->second.begin(), cached->second.end());
+  return page_count;
+}
+
+void DirectoryListing::Clear() {
+  directories_.clear();
+  lru_.clear();
+}
+
+bool DirectoryListing::SameDirectory(const struct stat& a, const struct stat& b) {
+  return a.st_dev == b.st_dev && a.st_ino == b.st_ino &&
+         a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+DirectoryListing::Directory& DirectoryListing::Load(const std::string& path,
+                                                    const struct stat& st) {
+  std::map<std::string, Directory>::iterator it = directories_.find(path);
+  if (it != directories_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    if (SameDirectory(it->second.st, st)) {
+      return it->second;
+    }
+  } else {
+    while (directories_.size() >= kMaxDirectories) {
+      directories_.erase(lru_.back());
+      lru_.pop_back();
+    }
+    lru_.push_front(path);
+    it = directories_.insert(std::make_pair(path, Directory())).first;
+    it->second.lru = lru_.begin();
+  }
+
+  Directory& directory = it->second;
+  directory.st = st;
+  directory.pages.clear();
+  directory.entries.clear();
+  Scan(path, &directory.entries);
+  return directory;
+}
+
+void DirectoryListing::Scan(const std::string& path, std::vector<Entry>* entries) {
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    return;
+  }
+
+  int dir_fd = dirfd(dir);
+  struct dirent* dirent;
+  while ((dirent = readdir(dir))) {
+    if (std::strcmp(dirent->d_name, ".") == 0 || std::strcmp(dirent->d_name, "..") == 0) {
+      continue;
+    }
+
+    struct stat file_stat;
+    if (fstatat(dir_fd, dirent->d_name, &file_stat, 0) != 0) {
+      continue;
+    }
+    Entry entry;
+    entry.name = dirent->d_name;
+    entry.is_directory = S_ISDIR(file_stat.st_mode);
+    entry.size = file_stat.st_size;
+    entry.mtime = file_stat.st_mtime;
+    entries->push_back(entry);
+  }
+  closedir(dir);
+  std::sort(entries->begin(), entries->end());
+}
+
+void DirectoryListing::RenderHtml(const Directory& directory, const std::string& request_path,
+                                  std::size_t first, std::size_t last,
+                                  std::size_t page, std::size_t page_count,
+                                  ChunkWriter* writer) {
+  static const std::size_t kNameColumn = 50;
+
+  writer->Append("<html>\n<head><title>Index of ");
+  AppendEscaped(request_path, kHtml, writer);
+  writer->Append("</title></head>\n<body>\n<h1>Index of ");
+  AppendEscaped(request_path, kHtml, writer);
+  writer->Append("</h1><hr><pre><a href=\"../\">../</a>\n");
+
+  std::time_t last_minute = -1;
+  char time_str[20] = "";
+  for (std::size_t i = first; i < last; ++i) {
+    const Entry& entry = directory.entries[i];
+    if (entry.mtime / 60 != last_minute) {
+      last_minute = entry.mtime / 60;
+      struct tm tm_mod_time;
+      localtime_r(&entry.mtime, &tm_mod_time);
+      std::strftime(time_str, sizeof(time_str), "%d-%b-%Y %H:%M", &tm_mod_time);
+    }
+
+    writer->Append("<a href=\"");
+    AppendEscaped(entry.name, kHtml, writer);
+    writer->Append("\">");
+    AppendEscaped(entry.name, kHtml, writer);
+    writer->Append("</a>");
+    if (entry.name.length() < kNameColumn) {
+      writer->Append(std::string(kNameColumn - entry.name.length(), ' '));
+    }
+    writer->Append(time_str, std::strlen(time_str));
+    writer->Append(" ", 1);
+    writer->AppendNumber(entry.size, 10);
+    writer->Append("\n", 1);
+  }
+  writer->Append("</pre><hr>");
+
+  if (page_count > 1) {
+    if (page > 1) {
+      writer->Append("<a href=\"?page=");
+      writer->AppendNumber(page - 1);
+      writer->Append("\">&laquo; prev</a> ");
+    }
+    writer->Append("page ");
+    writer->AppendNumber(page);
+    writer->Append(" of ");
+    writer->AppendNumber(page_count);
+    if (page < page_count) {
+      writer->Append(" <a href=\"?page=");
+      writer->AppendNumber(page + 1);
+      writer->Append("\">next &raquo;</a>");
+    }
+    writer->Append("<hr>");
+  }
+  writer->Append("</body>\n</html>");
+}
+
+void DirectoryListing::RenderJson(const Directory& directory, std::size_t first,
+                                  std::size_t last, ChunkWriter* writer) {
+  writer->Append("[");
+  for (std::size_t i = first; i < last; ++i) {
+    const Entry& entry = directory.entries[i];
+    writer->Append(i == first ? "\n{ \"name\":\"" : ",\n{ \"name\":\"");
+    AppendEscaped(entry.name, kJson, writer);
+    writer->Append(entry.is_directory ? "\", \"type\":\"directory\", \"mtime\":\""
+                                      : "\", \"type\":\"file\", \"mtime\":\"");
+    writer->Append(libft::FT_FormatHttpDate(entry.mtime));
+    writer->Append("\"");
+    if (!entry.is_directory) {
+      writer->Append(", \"size\":");
+      writer->AppendNumber(entry.size);
+    }
+    writer->Append(" }");
+  }
+  writer->Append("\n]\n");
+}
+
+void DirectoryListing::AppendEscaped(const std::string& value, Format format,
+                                     ChunkWriter* writer) {
+  std::string::size_type start = 0;
+  for (std::string::size_type i = 0; i < value.length(); ++i) {
+    unsigned char c = value[i];
+    const char* replacement = NULL;
+    char escaped[8];
+
+    if (format == kHtml) {
+      if (c == '&') {
+        replacement = "&amp;";
+      } else if (c == '<') {
+        replacement = "&lt;";
+      } else if (c == '>') {
+        replacement = "&gt;";
+      } else if (c == '"') {
+        replacement = "&quot;";
+      }
+    } else if (c == '"' || c == '\\') {
+      escaped[0] = '\\';
+      escaped[1] = c;
+      escaped[2] = '\0';
+      replacement = escaped;
+    } else if (c < 0x20) {
+      static const char kHex[] = "0123456789abcdef";
+      std::memcpy(escaped, "\\u00", 4);
+      escaped[4] = kHex[c >> 4];
+      escaped[5] = kHex[c & 0xf];
+      escaped[6] = '\0';
+      replacement = escaped;
+    }
+
+    if (replacement) {
+      writer->Append(value.data() + start, i - start);
+      writer->Append(replacement, std::strlen(replacement));
+      start = i + 1;
+    }
+  }
+  writer->Append(value.data() + start, value.length() - start);
+}
@@ -0,0 +1,286 @@
+#include "../../inc/Response/gzip_filter.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+
+const off_t GzipFilter::kStreamThreshold;
+const std::size_t GzipBodyFilter::kOutputSize;
+const std::size_t GzipBodyFilter::kReadSize;
+
+bool GzipFilter::ClientAccepts(const HttpRequest& request) {
+  const std::map<std::string, std::string>& headers = request.GetHeaders();
+  std::map<std::string, std::string>::const_iterator it = headers.find("accept-encoding");
+  if (it == headers.end()) {
+    return false;
+  }
+
+  // An explicit gzip entry overrides "*", so "gzip;q=0, *" refuses gzip.
+  double gzip_quality = -1;
+  double any_quality = -1;
+  std::string value = libft::FT_ToLower(it->second);
+  std::string::size_type pos = 0;
+  while (pos < value.length()) {
+    std::string::size_type comma = value.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = value.length();
+    }
+    std::string coding = value.substr(pos, comma - pos);
+    pos = comma + 1;
+
+    double quality = 1.0;
+    std::string::size_type semicolon = coding.find(';');
+    if (semicolon != std::string::npos) {
+      std::string params = coding.substr(semicolon + 1);
+      std::string::size_type q = params.find("q=");
+      if (q != std::string::npos) {
+        quality = std::atof(params.c_str() + q + 2);
+      }
+      coding.erase(semicolon);
+    }
+    coding = libft::FT_Trim(coding);
+    if (coding == "gzip" || coding == "x-gzip") {
+      gzip_quality = std::max(gzip_quality, quality);
+    } else if (coding == "*") {
+      any_quality = std::max(any_quality, quality);
+    }
+  }
+  return gzip_quality >= 0 ? gzip_quality > 0 : any_quality > 0;
+}
+
+bool GzipFilter::MatchesType(const BaseConfig& config, const std::string& content_type) {
+  std::string type = libft::FT_ToLower(libft::FT_Trim(content_type.substr(0, content_type.find(';'))));
+  if (type == "text/html") {
+    return true;
+  }
+
+  const std::vector<std::string>& types = config.GetGzipTypes();
+  for (std::vector<std::string>::const_iterator it = types.begin(); it != types.end(); ++it) {
+    if (*it == "*" || *it == type) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GzipFilter::Apply(const LocationConfig* location, bool accepts_gzip,
+                       HttpResponse* response) {
+  if (!Eligible(location, response)) {
+    return;
+  }
+
+  off_t length = response->GetBodyLength();
+  if (!accepts_gzip || length < static_cast<off_t>(location->GetGzipMinLength())) {
+    return;
+  }
+
+  // Large bodies are compressed by the body pipeline as they are sent, with
+  // chunked framing since the compressed length is not known up front.
+  std::string compressed;
+  if (length > kStreamThreshold) {
+    CompressWhileSending(response);
+  } else if (Compress(CollectBody(*response), &compressed)) {
+    response->SetBody(SharedBuffer::Adopt(compressed));
+  } else {
+    return;
+  }
+  MarkEncoded(response);
+}
+
+// For bodies whose length is not known when the head goes out. Only a
+// declared Content-Length can be checked against gzip_min_length.
+void GzipFilter::ApplyStream(const LocationConfig* location, bool accepts_gzip,
+                             HttpResponse* response) {
+  if (!Eligible(location, response)) {
+    return;
+  }
+
+  const std::string& length = response->GetHeader("Content-Length");
+  if (!accepts_gzip ||
+      (!length.empty() && std::atol(length.c_str()) <
+                              static_cast<long>(location->GetGzipMinLength()))) {
+    return;
+  }
+  CompressWhileSending(response);
+  MarkEncoded(response);
+}
+
+bool GzipFilter::Eligible(const LocationConfig* location, HttpResponse* response) {
+  if (!location || !location->GetGzip() || response->GetStatusCode() != 200 ||
+      !response->GetHeader("Content-Encoding").empty() ||
+      !MatchesType(*location, response->GetHeader("Content-Type"))) {
+    return false;
+  }
+  AddVary(response);
+  return true;
+}
+
+// A script may already vary on other request headers; Accept-Encoding is
+// added to its list rather than replacing it, and "*" covers it already.
+void GzipFilter::AddVary(HttpResponse* response) {
+  std::string vary = response->GetHeader("Vary");
+  std::string::size_type pos = 0;
+  while (pos < vary.length()) {
+    std::string::size_type comma = vary.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = vary.length();
+    }
+    std::string field = libft::FT_ToLower(libft::FT_Trim(vary.substr(pos, comma - pos)));
+    if (field == "accept-encoding" || field == "*") {
+      return;
+    }
+    pos = comma + 1;
+  }
+  response->SetHeader("Vary", vary.empty() ? "Accept-Encoding" : vary + ", Accept-Encoding");
+}
+
+void GzipFilter::CompressWhileSending(HttpResponse* response) {
+  response->SetCompressBody(true);
+  response->SetHeader("Transfer-Encoding", "chunked");
+  response->RemoveHeader("Content-Length");
+}
+
+void GzipFilter::MarkEncoded(HttpResponse* response) {
+  response->SetHeader("Content-Encoding", "gzip");
+  response->RemoveHeader("Accept-Ranges");
+  const std::string& etag = response->GetHeader("ETag");
+  if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+    response->SetHeader("ETag", "W/" + etag);
+  }
+}
+
+bool GzipFilter::Compress(const std::string& input, std::string* output) {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  output->resize(deflateBound(&stream, input.size()));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&(*output)[0]);
+  stream.avail_out = output->size();
+
+  int result = deflate(&stream, Z_FINISH);
+  output->resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+std::string GzipFilter::CollectBody(const HttpResponse& response) {
+  const SharedBuffer& buffer = response.GetBodyBuffer();
+  std::string body(buffer.Data(), buffer.Size());
+  const std::vector<BodySegment>& segments = response.GetBodySegments();
+  for (std::vector<BodySegment>::const_iterator it = segments.begin();
+       it != segments.end(); ++it) {
+    if (!it->file.Valid()) {
+      body.append(it->data.Data() + it->offset, static_cast<std::size_t>(it->length));
+      continue;
+    }
+    std::string::size_type start = body.size();
+    body.resize(start + static_cast<std::size_t>(it->length));
+    off_t done = 0;
+    while (done < it->length) {
+      ssize_t n = pread(it->file.Get(), &body[start + done], it->length - done,
+                        it->offset + done);
+      if (n <= 0) {
+        break;
+      }
+      done += n;
+    }
+    body.resize(start + done);
+  }
+  return body;
+}
+
+GzipBodyFilter::GzipBodyFilter() : initialized_(false), failed_(false), used_(0) {
+  std::memset(&stream_, 0, sizeof(stream_));
+  initialized_ = deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                              Z_DEFAULT_STRATEGY) == Z_OK;
+  failed_ = !initialized_;
+}
+
+GzipBodyFilter::~GzipBodyFilter() {
+  if (initialized_) {
+    deflateEnd(&stream_);
+  }
+}
+
+void GzipBodyFilter::Write(const BodySegment& segment) {
+  if (failed_) {
+    return;
+  }
+  if (!segment.file.Valid()) {
+    Deflate(segment.data.Data() + segment.offset,
+            static_cast<std::size_t>(segment.length), Z_NO_FLUSH);
+    return;
+  }
+
+  read_buffer_.resize(kReadSize);
+  off_t done = 0;
+  while (done < segment.length && !failed_) {
+    std::size_t want = static_cast<std::size_t>(
+        std::min(segment.length - done, static_cast<off_t>(kReadSize)));
+    ssize_t n = pread(segment.file.Get(), &read_buffer_[0], want, segment.offset + done);
+    if (n <= 0) {
+      failed_ = true;
+      return;
+    }
+    Deflate(read_buffer_.data(), static_cast<std::size_t>(n), Z_NO_FLUSH);
+    done += n;
+  }
+}
+
+void GzipBodyFilter::Finish() {
+  if (!failed_) {
+    Deflate(NULL, 0, Z_FINISH);
+  }
+  BodyFilter::Finish();
+}
+
+bool GzipBodyFilter::Failed() const {
+  return failed_;
+}
+
+void GzipBodyFilter::Deflate(const char* data, std::size_t size, int flush) {
+  stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream_.avail_in = size;
+
+  for (;;) {
+    if (output_.empty()) {
+      output_.resize(kOutputSize);
+      used_ = 0;
+    }
+    stream_.next_out = reinterpret_cast<Bytef*>(&output_[used_]);
+    stream_.avail_out = output_.size() - used_;
+
+    int result = deflate(&stream_, flush);
+    used_ = output_.size() - stream_.avail_out;
+    if (result == Z_STREAM_ERROR) {
+      failed_ = true;
+      return;
+    }
+    if (used_ == output_.size()) {
+      Emit();
+      continue;
+    }
+    if (flush == Z_FINISH ? result == Z_STREAM_END : stream_.avail_in == 0) {
+      break;
+    }
+  }
+
+  if (flush == Z_FINISH) {
+    Emit();
+  }
+}
+
+void GzipBodyFilter::Emit() {
+  if (used_ > 0) {
+    output_.resize(used_);
+    Forward(SharedBuffer::Adopt(output_));
+  }
+  output_.clear();
+  used_ = 0;
+}
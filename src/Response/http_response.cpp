@@ -1,6 +1,115 @@
 #include "../../inc/Response/http_response.h"
 
-HttpResponse::HttpResponse() : status_code_(200), clientFd_(-1), is_cgi_response_(false), is_cgi_processed_(false) {
+#include <strings.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace {
+
+const char* const kCanonicalHeaderNames[] = {
+  "Accept-Ranges", "Age", "Allow", "Cache-Control", "Connection",
+  "Content-Disposition", "Content-Encoding", "Content-Language",
+  "Content-Length", "Content-Location", "Content-Range", "Content-Type",
+  "Date", "ETag", "Expires", "Keep-Alive", "Last-Modified", "Link",
+  "Location", "Retry-After", "Server", "Set-Cookie", "Status",
+  "Transfer-Encoding", "Vary", "WWW-Authenticate", "X-Accel-Redirect",
+  "X-Powered-By", "X-Sendfile"
+};
+
+struct StatusLine {
+  int code;
+  const char* line;
+};
+
+const StatusLine kStatusLines[] = {
+  {100, "HTTP/1.1 100 Continue\r\n"},
+  {200, "HTTP/1.1 200 OK\r\n"},
+  {201, "HTTP/1.1 201 Created\r\n"},
+  {202, "HTTP/1.1 202 Accepted\r\n"},
+  {204, "HTTP/1.1 204 No Content\r\n"},
+  {206, "HTTP/1.1 206 Partial Content\r\n"},
+  {301, "HTTP/1.1 301 Moved Permanently\r\n"},
+  {302, "HTTP/1.1 302 Found\r\n"},
+  {303, "HTTP/1.1 303 See Other\r\n"},
+  {304, "HTTP/1.1 304 Not Modified\r\n"},
+  {307, "HTTP/1.1 307 Temporary Redirect\r\n"},
+  {308, "HTTP/1.1 308 Permanent Redirect\r\n"},
+  {400, "HTTP/1.1 400 Bad Request\r\n"},
+  {401, "HTTP/1.1 401 Unauthorized\r\n"},
+  {403, "HTTP/1.1 403 Forbidden\r\n"},
+  {404, "HTTP/1.1 404 Not Found\r\n"},
+  {405, "HTTP/1.1 405 Method Not Allowed\r\n"},
+  {408, "HTTP/1.1 408 Request Timeout\r\n"},
+  {409, "HTTP/1.1 409 Conflict\r\n"},
+  {410, "HTTP/1.1 410 Gone\r\n"},
+  {411, "HTTP/1.1 411 Length Required\r\n"},
+  {412, "HTTP/1.1 412 Precondition Failed\r\n"},
+  {413, "HTTP/1.1 413 Content Too Large\r\n"},
+  {414, "HTTP/1.1 414 URI Too Long\r\n"},
+  {415, "HTTP/1.1 415 Unsupported Media Type\r\n"},
+  {416, "HTTP/1.1 416 Range Not Satisfiable\r\n"},
+  {421, "HTTP/1.1 421 Misdirected Request\r\n"},
+  {422, "HTTP/1.1 422 Unprocessable Content\r\n"},
+  {426, "HTTP/1.1 426 Upgrade Required\r\n"},
+  {431, "HTTP/1.1 431 Request Header Fields Too Large\r\n"},
+  {500, "HTTP/1.1 500 Internal Server Error\r\n"},
+  {501, "HTTP/1.1 501 Not Implemented\r\n"},
+  {502, "HTTP/1.1 502 Bad Gateway\r\n"},
+  {503, "HTTP/1.1 503 Service Unavailable\r\n"},
+  {504, "HTTP/1.1 504 Gateway Timeout\r\n"},
+  {505, "HTTP/1.1 505 HTTP Version Not Supported\r\n"}
+};
+
+// "HTTP/1.1 NNN " prefix and trailing CRLF around the reason phrase.
+const std::size_t kStatusPrefixLength = 13;
+
+bool EqualsIgnoreCase(const std::string& a, const char* b) {
+  return a.size() == std::strlen(b) && strncasecmp(a.data(), b, a.size()) == 0;
+}
+
+const char* CanonicalHeaderName(const std::string& key) {
+  for (std::size_t i = 0;
+       i < sizeof(kCanonicalHeaderNames) / sizeof(kCanonicalHeaderNames[0]); ++i) {
+    if (EqualsIgnoreCase(key, kCanonicalHeaderNames[i])) {
+      return kCanonicalHeaderNames[i];
+    }
+  }
+  return NULL;
+}
+
+// Returns the precomputed status line when message is the standard reason
+// phrase for code.
+const char* FindStatusLine(int code, const std::string& message) {
+  for (std::size_t i = 0; i < sizeof(kStatusLines) / sizeof(kStatusLines[0]); ++i) {
+    if (kStatusLines[i].code != code) {
+      continue;
+    }
+    const char* reason = kStatusLines[i].line + kStatusPrefixLength;
+    std::size_t reason_length = std::strlen(reason) - 2;
+    if (message.size() == reason_length &&
+        message.compare(0, reason_length, reason, reason_length) == 0) {
+      return kStatusLines[i].line;
+    }
+    return NULL;
+  }
+  return NULL;
+}
+
+void AppendNumber(std::string* out, off_t value) {
+  char digits[24];
+  std::size_t pos = sizeof(digits);
+  do {
+    digits[--pos] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  out->append(digits + pos, sizeof(digits) - pos);
+}
+
+}  // namespace
+
+HttpResponse::HttpResponse()
+    : status_code_(200), header_count_(0), range_offset_(0), range_length_(-1),
+      compress_body_(false), clientFd_(-1), is_cgi_response_(false), is_cgi_processed_(false) {
 }
 
 HttpResponse::~HttpResponse() {
@@ -11,11 +120,92 @@ void HttpResponse::SetStatus(int code, const std::string& message) {
   status_message_ = message;
 }
 
+// Slots past header_count_ are kept after Clear() so a reused response
+// assigns into strings that already have capacity.
 void HttpResponse::SetHeader(const std::string& key, const std::string& value) {
-  headers_[libft::FT_ToLower(key)] = value;
+  std::size_t index = FindHeader(key);
+  if (index == header_count_) {
+    if (header_count_ == headers_.size()) {
+      headers_.push_back(HeaderField());
+    }
+    const char* canonical = CanonicalHeaderName(key);
+    if (canonical) {
+      headers_[index].name.assign(canonical);
+    } else {
+      headers_[index].name.assign(key);
+    }
+    ++header_count_;
+  }
+  headers_[index].value.assign(value);
+}
+
+void HttpResponse::RemoveHeader(const std::string& key) {
+  std::size_t index = FindHeader(key);
+  if (index == header_count_) {
+    return;
+  }
+  for (std::size_t i = index; i + 1 < header_count_; ++i) {
+    headers_[i].name.swap(headers_[i + 1].name);
+    headers_[i].value.swap(headers_[i + 1].value);
+  }
+  --header_count_;
+}
+
+std::size_t HttpResponse::FindHeader(const std::string& key) const {
+  for (std::size_t i = 0; i < header_count_; ++i) {
+    const std::string& name = headers_[i].name;
+    if (name.size() == key.size() &&
+        strncasecmp(name.data(), key.data(), key.size()) == 0) {
+      return i;
+    }
+  }
+  return header_count_;
+}
+
+void HttpResponse::SetBody(const std::string& body) {
+  body_ = SharedBuffer(body);
+  segments_.clear();
+}
+
+void HttpResponse::SetBody(const SharedBuffer& body) {
+  body_ = body;
+  segments_.clear();
+}
+
+void HttpResponse::SetBody(const BufferChain& body) {
+  body_ = SharedBuffer();
+  segments_.clear();
+  for (std::size_t i = 0; i < body.BufferCount(); ++i) {
+    AppendBody(body.Buffer(i));
+  }
+}
+
+void HttpResponse::AppendBody(const SharedBuffer& data) {
+  BodySegment segment;
+  segment.data = data;
+  segment.offset = 0;
+  segment.length = data.Size();
+  segments_.push_back(segment);
+}
+
+void HttpResponse::AppendFile(const SharedFd& file, off_t offset, off_t length) {
+  BodySegment segment;
+  segment.file = file;
+  segment.offset = offset;
+  segment.length = length;
+  segments_.push_back(segment);
+}
+
+// Limits what is sent to a slice of the assembled body; the range is applied
+// by the body pipeline so producers can hand over whole cached buffers.
+void HttpResponse::SetBodyRange(off_t offset, off_t length) {
+  range_offset_ = offset;
+  range_length_ = length;
 }
 
-void HttpResponse::SetBody(const std::string& body) { body_ = body; }
+void HttpResponse::SetCompressBody(bool compress) {
+  compress_body_ = compress;
+}
 
 void HttpResponse::SetClientFd(int fd)
 {
@@ -44,42 +234,115 @@ bool HttpResponse::GetIsCgiProcessed() const {
 }
 
 std::string HttpResponse::ToString() const {
-  std::stringstream ss;
-
-  ss << "HTTP/1.1 " << status_code_;
-  if (!status_message_.empty()) {
-    ss << " " << status_message_;
+  std::string out = SerializeHead();
+  std::string::size_type body_start = out.size();
+  out.append(body_.Data(), body_.Size());
+  for (std::vector<BodySegment>::const_iterator it = segments_.begin();
+       it != segments_.end(); ++it) {
+    if (!it->file.Valid()) {
+      out.append(it->data.Data() + it->offset, static_cast<std::size_t>(it->length));
+      continue;
+    }
+    std::string chunk(static_cast<std::size_t>(it->length), '\0');
+    ssize_t n = pread(it->file.Get(), &chunk[0], chunk.size(), it->offset);
+    out.append(chunk, 0, n > 0 ? n : 0);
+  }
+  if (HasBodyRange()) {
+    std::string::size_type start = body_start + static_cast<std::size_t>(range_offset_);
+    out.erase(body_start, std::min(start, out.size()) - body_start);
+    out.resize(std::min(out.size(), body_start + static_cast<std::size_t>(range_length_)));
   }
-  ss << "\r\n";
+  return out;
+}
 
-  for (std::map<std::string, std::string>::const_iterator it = headers_.begin();
-       it != headers_.end(); ++it) {
-    ss << libft::FT_StrCapitalize(it->first) << ": " << it->second << "\r\n";
+std::string HttpResponse::SerializeHead() const {
+  std::string out;
+  AppendHead(&out);
+  return out;
+}
+
+void HttpResponse::AppendHead(std::string* out) const {
+  std::size_t size = kStatusPrefixLength + status_message_.size() + 2 + 2;
+  for (std::size_t i = 0; i < header_count_; ++i) {
+    size += headers_[i].name.size() + headers_[i].value.size() + 4;
   }
+  out->reserve(out->size() + size + sizeof("Content-Length: \r\n") + 20);
 
-  if (headers_.find("content-length") == headers_.end()) {
-    ss << "Content-Length: " << body_.length() << "\r\n";
+  const char* status_line = FindStatusLine(status_code_, status_message_);
+  if (status_line) {
+    out->append(status_line);
+  } else {
+    out->append("HTTP/1.1 ", 9);
+    AppendNumber(out, status_code_);
+    if (!status_message_.empty()) {
+      out->push_back(' ');
+      out->append(status_message_);
+    }
+    out->append("\r\n", 2);
   }
 
-  ss << "\r\n";
+  bool has_content_length = false;
+  bool chunked = false;
+  for (std::size_t i = 0; i < header_count_; ++i) {
+    const HeaderField& field = headers_[i];
+    if (field.name == "Content-Length") {
+      has_content_length = true;
+    } else if (field.name == "Transfer-Encoding") {
+      chunked = true;
+    }
+    out->append(field.name);
+    out->append(": ", 2);
+    out->append(field.value);
+    out->append("\r\n", 2);
+  }
 
-  ss << body_;
+  bool has_body = status_code_ >= 200 && status_code_ != 204 && status_code_ != 304;
+  if (has_body && !has_content_length && !chunked) {
+    out->append("Content-Length: ", 16);
+    AppendNumber(out, GetBodyLength());
+    out->append("\r\n", 2);
+  }
 
-  return ss.str();
+  out->append("\r\n", 2);
 }
 
 int HttpResponse::GetStatusCode() const { return status_code_; }
 
-std::string HttpResponse::GetHeader(const std::string& key) const {
-  std::map<std::string, std::string>::const_iterator it = headers_.find(libft::FT_ToLower(key));
-  return (it != headers_.end()) ? it->second : "";
+const std::string& HttpResponse::GetHeader(const std::string& key) const {
+  static const std::string empty;
+  std::size_t index = FindHeader(key);
+  return index < header_count_ ? headers_[index].value : empty;
+}
+
+std::size_t HttpResponse::GetHeaderCount() const { return header_count_; }
+
+const HeaderField& HttpResponse::GetHeaderField(std::size_t index) const {
+  return headers_[index];
 }
 
-const std::map<std::string, std::string>& HttpResponse::GetHeaders() const {
-  return headers_;
+const SharedBuffer& HttpResponse::GetBodyBuffer() const { return body_; }
+
+const std::vector<BodySegment>& HttpResponse::GetBodySegments() const {
+  return segments_;
 }
 
-std::string HttpResponse::GetBody() const { return body_; }
+off_t HttpResponse::GetBodyLength() const {
+  if (HasBodyRange()) {
+    return range_length_;
+  }
+  off_t length = body_.Size();
+  for (std::vector<BodySegment>::const_iterator it = segments_.begin();
+       it != segments_.end(); ++it) {
+    length += it->length;
+  }
+  return length;
+}
+
+bool HttpResponse::HasBodyRange() const { return range_length_ >= 0; }
+
+off_t HttpResponse::GetBodyRangeOffset() const { return range_offset_; }
+
+bool HttpResponse::GetCompressBody() const { return compress_body_; }
 
 const std::string& HttpResponse::GetStatusMessage() const {
   return status_message_;
@@ -89,8 +352,12 @@ void HttpResponse::Clear()
 {
     status_code_ = 0;
     status_message_.clear();
-    headers_.clear();
-    body_.clear();
+    header_count_ = 0;
+    body_ = SharedBuffer();
+    segments_.clear();
+    range_offset_ = 0;
+    range_length_ = -1;
+    compress_body_ = false;
     is_cgi_response_ = false;
     is_cgi_processed_ = false;
 }
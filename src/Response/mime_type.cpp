@@ -1,35 +1,87 @@
 #include "../../inc/Response/mime_type.h"
 
-std::map<std::string, std::string>& MimeType::GetMimeTypes() {
-  static std::map<std::string, std::string> mime_types;
-  static bool initialized = false;
-
-  if (!initialized) {
-    mime_types["html"] = "text/html";
-    mime_types["htm"] = "text/html";
-    mime_types["css"] = "text/css";
-    mime_types["js"] = "text/javascript";
-    mime_types["txt"] = "text/plain";
-    mime_types["jpg"] = "image/jpeg";
-    mime_types["jpeg"] = "image/jpeg";
-    mime_types["png"] = "image/png";
-    mime_types["gif"] = "image/gif";
-    mime_types["ico"] = "image/x-icon";
-    mime_types["xml"] = "text/xml";
-    mime_types["pdf"] = "application/pdf";
-    mime_types["zip"] = "application/zip";
-    mime_types["gz"] = "application/gzip";
-    mime_types["json"] = "application/json";
-    initialized = true;
+namespace {
+
+// Default value for unknown file types mentioned in RFC 9110.
+const char kDefaultType[] = "application/octet-stream";
+
+const char* const kBuiltinTypes[][2] = {
+  {"html", "text/html"},
+  {"htm", "text/html"},
+  {"shtml", "text/html"},
+  {"css", "text/css"},
+  {"xml", "text/xml"},
+  {"txt", "text/plain"},
+  {"csv", "text/csv"},
+  {"md", "text/markdown"},
+  {"js", "text/javascript"},
+  {"mjs", "text/javascript"},
+  {"json", "application/json"},
+  {"map", "application/json"},
+  {"wasm", "application/wasm"},
+  {"pdf", "application/pdf"},
+  {"rss", "application/rss+xml"},
+  {"atom", "application/atom+xml"},
+  {"zip", "application/zip"},
+  {"gz", "application/gzip"},
+  {"tar", "application/x-tar"},
+  {"7z", "application/x-7z-compressed"},
+  {"bin", "application/octet-stream"},
+  {"gif", "image/gif"},
+  {"jpeg", "image/jpeg"},
+  {"jpg", "image/jpeg"},
+  {"png", "image/png"},
+  {"svg", "image/svg+xml"},
+  {"svgz", "image/svg+xml"},
+  {"webp", "image/webp"},
+  {"avif", "image/avif"},
+  {"ico", "image/x-icon"},
+  {"bmp", "image/bmp"},
+  {"woff", "font/woff"},
+  {"woff2", "font/woff2"},
+  {"ttf", "font/ttf"},
+  {"otf", "font/otf"},
+  {"mp3", "audio/mpeg"},
+  {"ogg", "audio/ogg"},
+  {"wav", "audio/wav"},
+  {"mp4", "video/mp4"},
+  {"webm", "video/webm"},
+  {"mov", "video/quicktime"},
+};
+
+}  // namespace
+
+const MimeTypeTable& MimeType::BuiltinTypes() {
+  static MimeTypeTable table;
+  if (table.Empty()) {
+    for (std::size_t i = 0; i < sizeof(kBuiltinTypes) / sizeof(kBuiltinTypes[0]); ++i) {
+      table.Add(kBuiltinTypes[i][0], kBuiltinTypes[i][1]);
+    }
   }
-  return mime_types;
+  return table;
+}
+
+const char* MimeType::GetType(const char* extension, std::size_t length) {
+  const char* type = BuiltinTypes().Find(extension, length);
+  return type ? type : kDefaultType;
+}
+
+const char* MimeType::GetType(const std::string& extension) {
+  return GetType(extension.data(), extension.size());
 }
 
-std::string MimeType::GetType(const std::string& extension) {
-  std::map<std::string, std::string>::iterator it =
-      GetMimeTypes().find(extension);
-  if (it != GetMimeTypes().end()) {
-    return it->second;
+const char* MimeType::ForPath(const BaseConfig& config, const std::string& path) {
+  std::string::size_type dot = path.find_last_of("./");
+  if (dot == std::string::npos || path[dot] != '.') {
+    return kDefaultType;
+  }
+
+  const char* extension = path.data() + dot + 1;
+  std::size_t length = path.size() - dot - 1;
+  const MimeTypeTable& types = config.GetTypes();
+  if (!types.Defined()) {
+    return GetType(extension, length);
   }
-  return "application/octet-stream"; // Default value for unknown file types metioned in the RFC 9110
+  const char* type = types.Find(extension, length);
+  return type ? type : kDefaultType;
 }
@@ -0,0 +1,170 @@
+#include "../../inc/Response/open_file_cache.h"
+
+#include <sys/time.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+OpenFileInfo::OpenFileInfo() : fd(-1), error(0), readable(false), owns_fd(false) {
+  std::memset(&st, 0, sizeof(st));
+}
+
+OpenFileInfo::~OpenFileInfo() {
+  if (owns_fd && fd >= 0) {
+    close(fd);
+  }
+}
+
+OpenFileCache::OpenFileCache() {}
+
+OpenFileCache::~OpenFileCache() {
+  Clear();
+}
+
+OpenFileCache& OpenFileCache::Instance() {
+  static OpenFileCache instance;
+  return instance;
+}
+
+time_t OpenFileCache::NowMs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+void OpenFileCache::Probe(const std::string& path, Entry* entry) {
+  entry->fd = -1;
+  if (stat(path.c_str(), &entry->st) != 0) {
+    entry->error = errno;
+    std::memset(&entry->st, 0, sizeof(entry->st));
+    entry->readable = false;
+    return;
+  }
+  entry->error = 0;
+  entry->readable = access(path.c_str(), R_OK) == 0;
+}
+
+bool OpenFileCache::SameFile(const struct stat& a, const struct stat& b) {
+  return a.st_dev == b.st_dev && a.st_ino == b.st_ino &&
+         a.st_size == b.st_size && a.st_mode == b.st_mode &&
+         a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec &&
+         a.st_ctim.tv_sec == b.st_ctim.tv_sec && a.st_ctim.tv_nsec == b.st_ctim.tv_nsec;
+}
+
+bool OpenFileCache::Lookup(const std::string& path, const BaseConfig& config,
+                           bool open_file, OpenFileInfo* info) {
+  if (config.GetOpenFileCacheMax() == 0) {
+    Entry entry;
+    Probe(path, &entry);
+    if (!entry.error && open_file && S_ISREG(entry.st.st_mode)) {
+      entry.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (entry.fd < 0) {
+        entry.error = errno;
+      }
+    }
+    info->owns_fd = true;
+    return Fill(entry, open_file, info);
+  }
+
+  time_t now = NowMs();
+  Expire(now);
+
+  std::map<std::string, Entry>::iterator it = entries_.find(path);
+  if (it == entries_.end()) {
+    Entry entry;
+    Probe(path, &entry);
+    if (entry.error && !config.GetOpenFileCacheErrors()) {
+      return Fill(entry, open_file, info);
+    }
+    entry.validated_ms = now;
+    entry.inactive_ms = config.GetOpenFileCacheInactive();
+    lru_.push_front(path);
+    entry.lru = lru_.begin();
+    entry.expiry = expiry_.insert(std::make_pair(now + entry.inactive_ms, path));
+    it = entries_.insert(std::make_pair(path, entry)).first;
+  } else {
+    if (now - it->second.validated_ms >= config.GetOpenFileCacheValid() ||
+        (it->second.error && !config.GetOpenFileCacheErrors())) {
+      Revalidate(path, &it->second);
+      it->second.validated_ms = now;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    expiry_.erase(it->second.expiry);
+    it->second.expiry = expiry_.insert(std::make_pair(now + it->second.inactive_ms, path));
+  }
+
+  Entry& entry = it->second;
+
+  if (!entry.error && open_file && S_ISREG(entry.st.st_mode) && entry.fd < 0) {
+    entry.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (entry.fd < 0) {
+      entry.error = errno;
+    }
+  }
+
+  bool found = Fill(entry, open_file, info);
+  if (entry.error && !config.GetOpenFileCacheErrors()) {
+    Erase(it);
+  }
+
+  while (entries_.size() > config.GetOpenFileCacheMax()) {
+    Erase(entries_.find(lru_.back()));
+  }
+  return found;
+}
+
+void OpenFileCache::Revalidate(const std::string& path, Entry* entry) {
+  struct stat st;
+  if (!entry->error && stat(path.c_str(), &st) == 0 && SameFile(st, entry->st)) {
+    return;
+  }
+  if (entry->fd >= 0) {
+    close(entry->fd);
+  }
+  Probe(path, entry);
+}
+
+// Locations may use different inactive periods, so entries are expired in
+// deadline order rather than from the LRU tail.
+void OpenFileCache::Expire(time_t now) {
+  while (!expiry_.empty() && expiry_.begin()->first <= now) {
+    Erase(entries_.find(expiry_.begin()->second));
+  }
+}
+
+void OpenFileCache::Erase(std::map<std::string, Entry>::iterator it) {
+  if (it->second.fd >= 0) {
+    close(it->second.fd);
+  }
+  lru_.erase(it->second.lru);
+  expiry_.erase(it->second.expiry);
+  entries_.erase(it);
+}
+
+bool OpenFileCache::Fill(const Entry& entry, bool open_file, OpenFileInfo* info) const {
+  info->st = entry.st;
+  info->error = entry.error;
+  info->readable = entry.readable;
+  info->fd = open_file ? entry.fd : -1;
+  return entry.error == 0;
+}
+
+void OpenFileCache::Invalidate(const std::string& path) {
+  std::map<std::string, Entry>::iterator it = entries_.find(path);
+  if (it != entries_.end()) {
+    Erase(it);
+  }
+}
+
+void OpenFileCache::Clear() {
+  for (std::map<std::string, Entry>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    if (it->second.fd >= 0) {
+      close(it->second.fd);
+    }
+  }
+  entries_.clear();
+  lru_.clear();
+  expiry_.clear();
+}
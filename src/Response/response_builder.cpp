@@ -1,5 +1,9 @@
 #include "../../inc/Response/response_builder.h"
 #include "../../inc/Web/client_connection.h"
+#include "../../inc/Cgi/cgi_cache.h"
+#include "../../inc/Cgi/cgi_limiter.h"
+#include "../../inc/Cgi/fastcgi_client.h"
+#include "../../inc/Util/http_date.h"
 
 
 ResponseBuilder::ResponseBuilder(ServerConfig *config)
@@ -38,8 +42,8 @@ void ResponseBuilder::ExecuteRequest(const HttpRequest &request)
       return;
     }
 
-    const LocationConfig *location = FindMatchingLocation(request, config_);
-    if (!location)
+    const LocationConfig *location = request.GetLocation();
+    if (!location || (location->IsInternal() && !request.IsInternal()))
     {
       throw NotFoundException();
     }
@@ -93,17 +97,21 @@ bool ResponseBuilder::IsMethodAccepted(const std::string &method,
 }
 
 std::string ResponseBuilder::ResolveRootPath(
-    const std::string &location_root, const ServerConfig &config) const
+    const LocationConfig *location, const ServerConfig &config) const
 {
+  const std::string &location_root = location->GetRoot();
   if (location_root.empty())
   {
     throw InternalServerErrorException();
   }
 
-  std::string resolved_path = CombineRootPaths(location_root, config);
-  ValidateResolvedPath(resolved_path);
-  NormalizePathSeparators(resolved_path);
-  ValidateDirectoryAccess(resolved_path);
+  std::string resolved_path;
+  if (!parsing_utils::NormalizePath(CombineRootPaths(location_root, config),
+                                   false, resolved_path))
+  {
+    throw ForbiddenException();
+  }
+  ValidateDirectoryAccess(resolved_path, location);
 
   return resolved_path;
 }
@@ -126,53 +134,73 @@ std::string ResponseBuilder::CombineRootPaths(
   }
 }
 
-void ResponseBuilder::ValidateResolvedPath(const std::string &resolved_path) const
+// Maps an X-Sendfile path to the URI that serves it, through the internal
+// location whose root holds the file.
+bool ResponseBuilder::FindInternalUri(const std::string &file, std::string *uri) const
 {
-  if (resolved_path.find("..") != std::string::npos)
+  std::string path;
+  if (!parsing_utils::NormalizePath(file, false, path))
   {
-    throw ForbiddenException();
+    return false;
   }
-}
 
-void ResponseBuilder::NormalizePathSeparators(std::string &resolved_path) const
-{
-  std::string::iterator it = resolved_path.begin();
-  std::string::iterator next;
-  while ((next = std::find(it, resolved_path.end(), '/')) != resolved_path.end())
+  const std::map<std::string, LocationConfig *> &locations = config_->GetLocations();
+  for (std::map<std::string, LocationConfig *>::const_iterator it = locations.begin();
+       it != locations.end(); ++it)
   {
-    it = next;
-    while (++next != resolved_path.end() && *next == '/')
-      ;
-    if (next - it > 1)
+    const LocationConfig *location = it->second;
+    const std::string &location_root = location->GetRoot();
+    if (!location->IsInternal() || location_root.empty() ||
+        (location_root[0] != '/' && config_->GetRoot().empty()))
     {
-      resolved_path.erase(it + 1, next);
-      it = resolved_path.begin();
+      continue;
     }
-    else
+
+    std::string root;
+    if (!parsing_utils::NormalizePath(CombineRootPaths(location_root, *config_), false, root))
     {
-      ++it;
+      continue;
     }
+    if (root.size() > 1 && root[root.size() - 1] == '/')
+    {
+      root.erase(root.size() - 1);
+    }
+    if (path.compare(0, root.size(), root) != 0 ||
+        (path.size() > root.size() && path[root.size()] != '/'))
+    {
+      continue;
+    }
+
+    std::string prefix = location->GetPath();
+    if (!prefix.empty() && prefix[prefix.size() - 1] == '/')
+    {
+      prefix.erase(prefix.size() - 1);
+    }
+    *uri = prefix + path.substr(root.size());
+    return true;
   }
+  return false;
 }
 
-void ResponseBuilder::ValidateDirectoryAccess(const std::string &resolved_path) const
+void ResponseBuilder::ValidateDirectoryAccess(const std::string &resolved_path,
+                                              const LocationConfig *location) const
 {
-  struct stat path_stat;
-  if (stat(resolved_path.c_str(), &path_stat) != 0)
+  OpenFileInfo info;
+  if (!OpenFileCache::Instance().Lookup(resolved_path, *location, false, &info))
   {
-    if (errno == EACCES)
+    if (info.error == EACCES)
     {
       throw ForbiddenException();
     }
     throw NotFoundException();
   }
 
-  if (!S_ISDIR(path_stat.st_mode))
+  if (!S_ISDIR(info.st.st_mode))
   {
     throw InternalServerErrorException();
   }
 
-  if (access(resolved_path.c_str(), R_OK) != 0)
+  if (!info.readable)
   {
     throw ForbiddenException();
   }
@@ -183,7 +211,7 @@ std::string ResponseBuilder::ResolveFinalPath(const LocationConfig *location,
                                               const ServerConfig &config,
                                               bool *is_directory)
 {
-  std::string resolved_root = ResolveRootPath(location->GetRoot(), config);
+  std::string resolved_root = ResolveRootPath(location, config);
   std::string remaining_path = ExtractRemainingPath(location, request);
   std::string final_path = CombinePaths(resolved_root, remaining_path);
 
@@ -196,7 +224,7 @@ std::string ResponseBuilder::ResolveFinalPath(const LocationConfig *location,
     return final_path;
   }
 
-  return ValidateAndCheckPath(final_path, is_directory);
+  return ValidateAndCheckPath(final_path, location, is_directory);
 }
 
 std::string ResponseBuilder::ExtractRemainingPath(const LocationConfig *location,
@@ -215,19 +243,23 @@ std::string ResponseBuilder::ExtractRemainingPath(const LocationConfig *location
 std::string ResponseBuilder::CombinePaths(const std::string &root_path,
                                         const std::string &remaining_path) const
 {
-  std::string normalized_root = root_path;
-
-  if (!normalized_root.empty() && normalized_root[normalized_root.length() - 1] == '/')
+  if (!root_path.empty() && root_path[root_path.length() - 1] == '/' &&
+      !remaining_path.empty())
   {
-    normalized_root = normalized_root.substr(0, normalized_root.length() - 1);
+    return root_path.substr(0, root_path.length() - 1) + remaining_path;
   }
 
-  return normalized_root + remaining_path;
+  return root_path + remaining_path;
 }
 
 bool ResponseBuilder::IsCgiPath(const HttpRequest &request,
                               const LocationConfig *location) const
 {
+  if (!location->GetFastCgiPass().empty())
+  {
+    return true;
+  }
+
   size_t lastDot = request.GetPath().find_last_of('.');
   if (lastDot != std::string::npos)
   {
@@ -241,15 +273,17 @@ bool ResponseBuilder::IsCgiPath(const HttpRequest &request,
   return false;
 }
 
-std::string ResponseBuilder::ValidateAndCheckPath(const std::string &path, bool *is_directory) const
+std::string ResponseBuilder::ValidateAndCheckPath(const std::string &path,
+                                                  const LocationConfig *location,
+                                                  bool *is_directory) const
 {
-  struct stat file_stat;
-  if (stat(path.c_str(), &file_stat) != 0)
+  OpenFileInfo info;
+  if (!OpenFileCache::Instance().Lookup(path, *location, false, &info))
   {
     throw NotFoundException();
   }
 
-  bool is_dir = S_ISDIR(file_stat.st_mode);
+  bool is_dir = S_ISDIR(info.st.st_mode);
   if (is_directory != NULL)
   {
     *is_directory = is_dir;
@@ -262,7 +296,12 @@ void ResponseBuilder::HandleGetRequest(const HttpRequest &request,
                                        HttpResponse *response,
                                        const ServerConfig &config)
 {
-  const LocationConfig *location = FindMatchingLocation(request, &config);
+  const LocationConfig *location = request.GetLocation();
+  if (ServeFromStaticCache(request, location, response))
+  {
+    return;
+  }
+
   bool is_directory;
   std::string final_path = ResolveFinalPath(location, request, config, &is_directory);
 
@@ -280,7 +319,7 @@ void ResponseBuilder::HandleGetRequest(const HttpRequest &request,
     }
     else if (location->GetAutoindex())
     {
-      ServeDirectoryListing(final_path, request.GetPath(), response);
+      ServeDirectoryListing(request, final_path, location, response);
       return;
     }
     else
@@ -289,13 +328,171 @@ void ResponseBuilder::HandleGetRequest(const HttpRequest &request,
     }
   }
 
-  ServeRegularFile(final_path, response);
+  ServeRegularFile(request, final_path, location, response);
+}
+
+bool ResponseBuilder::ServeFromStaticCache(const HttpRequest &request,
+                                           const LocationConfig *location,
+                                           HttpResponse *response) const
+{
+  if (location->GetStaticCacheMaxSize() == 0)
+  {
+    return false;
+  }
+
+  std::map<std::string, std::string>::const_iterator range_header =
+      request.GetHeaders().find("range");
+  bool has_range = range_header != request.GetHeaders().end();
+  if (!has_range && location->GetGzipStatic() && GzipFilter::ClientAccepts(request))
+  {
+    return false;
+  }
+
+  const StaticCacheEntry *entry = StaticCache::Instance().Find(location, request.GetPath());
+  if (!entry)
+  {
+    return false;
+  }
+
+  OpenFileInfo info;
+  if (!OpenFileCache::Instance().Lookup(entry->file_path, *location, false, &info) ||
+      !StaticCache::IsCurrent(*entry, info.st))
+  {
+    StaticCache::Instance().Remove(location, request.GetPath());
+    return false;
+  }
+
+  std::vector<ByteRange> ranges;
+  bool ranged = has_range && IfRangeMatches(request, entry->st) &&
+                ParseRangeHeader(range_header->second, entry->st.st_size, &ranges);
+  if (ranged && ranges.size() != 1)
+  {
+    return false;
+  }
+
+  if (CheckPreconditions(request, entry->st, response))
+  {
+    return true;
+  }
+
+  response->SetHeader("Content-Type", entry->content_type);
+  response->SetHeader("Accept-Ranges", "bytes");
+  SetValidators(entry->st, response);
+  response->SetBody(entry->body);
+
+  if (ranged)
+  {
+    std::ostringstream content_range;
+    content_range << "bytes " << ranges[0].first << '-' << ranges[0].last
+                  << '/' << entry->st.st_size;
+    response->SetStatus(206, "Partial Content");
+    response->SetHeader("Content-Range", content_range.str());
+    response->SetBodyRange(ranges[0].first, ranges[0].last - ranges[0].first + 1);
+    return true;
+  }
+
+  response->SetStatus(200, "OK");
+  return true;
+}
+
+std::string ResponseBuilder::MakeEntityTag(const struct stat &st) const
+{
+  std::ostringstream oss;
+  oss << std::hex << '"' << st.st_ino << '-' << st.st_mtime << '-' << st.st_size << '"';
+  return oss.str();
+}
+
+bool ResponseBuilder::EntityTagMatches(const std::string &header_value,
+                                       const std::string &etag,
+                                       bool weak) const
+{
+  std::string::size_type pos = 0;
+  while (pos < header_value.length())
+  {
+    std::string::size_type comma = header_value.find(',', pos);
+    if (comma == std::string::npos)
+    {
+      comma = header_value.length();
+    }
+    std::string tag = libft::FT_Trim(header_value.substr(pos, comma - pos));
+    pos = comma + 1;
+
+    if (tag == "*")
+    {
+      return true;
+    }
+    if (tag.compare(0, 2, "W/") == 0)
+    {
+      if (!weak)
+      {
+        continue;
+      }
+      tag.erase(0, 2);
+    }
+    if (tag == etag)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ResponseBuilder::SetValidators(const struct stat &st, HttpResponse *response) const
+{
+  response->SetHeader("ETag", MakeEntityTag(st));
+  response->SetHeader("Last-Modified", libft::FT_FormatHttpDate(st.st_mtime));
+}
+
+bool ResponseBuilder::CheckPreconditions(const HttpRequest &request,
+                                         const struct stat &st,
+                                         HttpResponse *response) const
+{
+  const std::map<std::string, std::string> &headers = request.GetHeaders();
+  std::map<std::string, std::string>::const_iterator it;
+  std::time_t since;
+
+  if ((it = headers.find("if-match")) != headers.end())
+  {
+    if (!EntityTagMatches(it->second, MakeEntityTag(st), false))
+    {
+      throw PreconditionFailedException();
+    }
+  }
+  else if ((it = headers.find("if-unmodified-since")) != headers.end())
+  {
+    if (libft::FT_ParseHttpDate(it->second, &since) && st.st_mtime > since)
+    {
+      throw PreconditionFailedException();
+    }
+  }
+
+  bool not_modified = false;
+  if ((it = headers.find("if-none-match")) != headers.end())
+  {
+    not_modified = EntityTagMatches(it->second, MakeEntityTag(st), true);
+  }
+  else if ((it = headers.find("if-modified-since")) != headers.end())
+  {
+    not_modified = libft::FT_ParseHttpDate(it->second, &since) && st.st_mtime <= since;
+  }
+
+  if (not_modified)
+  {
+    response->SetStatus(304, "Not Modified");
+    SetValidators(st, response);
+  }
+  return not_modified;
 }
 
 bool ResponseBuilder::ShouldHandleAsCgi(const HttpRequest &request,
                                       const std::string &path,
                                       const LocationConfig *location)
 {
+  if (!location->GetFastCgiPass().empty())
+  {
+    return true;
+  }
+
   std::string request_path = request.GetPath();
   size_t lastDot = request_path.find_last_of('.');
 
@@ -337,9 +534,9 @@ bool ResponseBuilder::TryFindIndexFile(const std::string &path,
     }
     index_path_str += *it;
 
-    struct stat file_stat;
-    if (stat(index_path_str.c_str(), &file_stat) == 0 &&
-        S_ISREG(file_stat.st_mode))
+    OpenFileInfo info;
+    if (OpenFileCache::Instance().Lookup(index_path_str, *location, false, &info) &&
+        S_ISREG(info.st.st_mode))
     {
       *index_path = index_path_str;
       return true;
@@ -349,124 +546,388 @@ bool ResponseBuilder::TryFindIndexFile(const std::string &path,
   return false;
 }
 
-void ResponseBuilder::ServeDirectoryListing(const std::string &dir_path,
-                                          const std::string &request_path,
-                                          HttpResponse *response) const
+void ResponseBuilder::ServeDirectoryListing(const HttpRequest &request,
+                                            const std::string &dir_path,
+                                            const LocationConfig *location,
+                                            HttpResponse *response) const
 {
-  std::string listing = GenerateDirectoryListing(dir_path, request_path);
+  OpenFileInfo info;
+  if (!OpenFileCache::Instance().Lookup(dir_path, *location, false, &info))
+  {
+    throw NotFoundException();
+  }
+
+  std::size_t page_size = location->GetAutoindexPageSize();
+  std::size_t page = 1;
+  if (page_size > 0)
+  {
+    page = ParsePageParameter(request.GetQueryString());
+  }
+
+  bool json = location->GetAutoindexFormat() == "json";
+  std::vector<SharedBuffer> chunks;
+  std::size_t page_count = DirectoryListing::Instance().Render(
+      dir_path, info.st, request.GetPath(),
+      json ? DirectoryListing::kJson : DirectoryListing::kHtml,
+      page_size, page, &chunks);
+  if (page_count == 0)
+  {
+    throw NotFoundException();
+  }
+
   response->SetStatus(200, "OK");
-  response->SetHeader("Content-Type", "text/html");
-  response->SetBody(listing);
+  response->SetHeader("Content-Type", json ? "application/json" : "text/html");
+  if (page_count > 1)
+  {
+    std::ostringstream link;
+    if (page > 1)
+    {
+      link << "<?page=" << page - 1 << ">; rel=\"prev\"";
+    }
+    if (page < page_count)
+    {
+      link << (page > 1 ? ", " : "") << "<?page=" << page + 1 << ">; rel=\"next\"";
+    }
+    response->SetHeader("Link", link.str());
+  }
+
+  response->SetBody(SharedBuffer());
+  for (std::vector<SharedBuffer>::const_iterator it = chunks.begin();
+       it != chunks.end(); ++it)
+  {
+    response->AppendBody(*it);
+  }
 }
 
-std::string ResponseBuilder::CreateDirectoryHeader(const std::string &request_path) const
+std::size_t ResponseBuilder::ParsePageParameter(const std::string &query) const
 {
-  std::stringstream header;
-  header << "<html>\n"
-         << "<head><title>Index of " << request_path << "</title></head>\n"
-         << "<body>\n"
-         << "<h1>Index of " << request_path
-         << "</h1><hr><pre><a href=\"../\">../</a>\n";
-  return header.str();
+  std::string::size_type pos = 0;
+  while (pos < query.length())
+  {
+    std::string::size_type amp = query.find('&', pos);
+    if (amp == std::string::npos)
+    {
+      amp = query.length();
+    }
+    if (query.compare(pos, 5, "page=") == 0)
+    {
+      std::string value = query.substr(pos + 5, amp - pos - 5);
+      std::size_t page = 0;
+      std::istringstream iss(value);
+      if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos ||
+          !(iss >> page))
+      {
+        return 0;
+      }
+      return page;
+    }
+    pos = amp + 1;
+  }
+  return 1;
 }
 
-std::string ResponseBuilder::CreateDirectoryEntry(const std::string &entry_name,
-                                                const struct stat &file_stat) const
+void ResponseBuilder::ServeRegularFile(const HttpRequest &request,
+                                     const std::string &file_path,
+                                     const LocationConfig *location,
+                                     HttpResponse *response) const
 {
-  std::time_t mod_time = file_stat.st_mtime;
-  std::tm *tm_mod_time = std::localtime(&mod_time);
+  OpenFileInfo info;
+  bool found = OpenFileCache::Instance().Lookup(file_path, *location, true, &info);
+
+  if (!S_ISREG(info.st.st_mode))
+  {
+    throw ForbiddenException();
+  }
+
+  if (!found || info.fd < 0)
+  {
+    throw NotFoundException();
+  }
+
+  std::string mimeType = MimeType::ForPath(*location, file_path);
+  off_t size = info.st.st_size;
+
+  std::map<std::string, std::string>::const_iterator range_header =
+      request.GetHeaders().find("range");
+  if (location->GetGzipStatic() && range_header == request.GetHeaders().end())
+  {
+    response->SetHeader("Vary", "Accept-Encoding");
+    if (GzipFilter::ClientAccepts(request) &&
+        ServePrecompressed(request, file_path, mimeType, location, response))
+    {
+      return;
+    }
+  }
+
+  if (CheckPreconditions(request, info.st, response))
+  {
+    return;
+  }
+
+  std::vector<ByteRange> ranges;
+  bool ranged = range_header != request.GetHeaders().end() &&
+                IfRangeMatches(request, info.st) &&
+                ParseRangeHeader(range_header->second, size, &ranges);
+  if (ranged && ranges.empty())
+  {
+    std::ostringstream content_range;
+    content_range << "bytes */" << size;
+    response->SetHeader("Content-Range", content_range.str());
+    throw RangeNotSatisfiableException();
+  }
 
-  char time_str[20];
-  std::strftime(time_str, sizeof(time_str), "%d-%b-%Y %H:%M", tm_mod_time);
+  bool cacheable = !ranged && location->GetStaticCacheMaxSize() > 0 &&
+                   static_cast<std::size_t>(size) <= location->GetStaticCacheMaxFile();
+  SharedFd file;
+  if (!cacheable)
+  {
+    file = SharedFd(fcntl(info.fd, F_DUPFD_CLOEXEC, 0));
+    if (!file.Valid())
+    {
+      throw InternalServerErrorException();
+    }
+  }
 
-  std::stringstream size_stream;
-  size_stream << file_stat.st_size;
+  SetValidators(info.st, response);
+  response->SetHeader("Accept-Ranges", "bytes");
 
-  std::stringstream entry;
-  entry << "<a href=\"" << entry_name << "\">" << entry_name
-        << "</a>" << std::string(50 - entry_name.length(), ' ')
-        << time_str << " " << std::setw(10) << size_stream.str()
-        << "\n";
+  if (ranged)
+  {
+    ServeRanges(ranges, file, info.st, mimeType, response);
+    return;
+  }
+
+  response->SetStatus(200, "OK");
+  response->SetHeader("Content-Type", mimeType);
 
-  return entry.str();
+  if (!cacheable)
+  {
+    response->SetBody(SharedBuffer());
+    response->AppendFile(file, 0, size);
+    return;
+  }
+
+  std::string body(static_cast<std::size_t>(size), '\0');
+  std::size_t total = 0;
+  while (total < body.size())
+  {
+    ssize_t bytes = pread(info.fd, &body[total], body.size() - total, total);
+    if (bytes < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytes <= 0)
+    {
+      break;
+    }
+    total += bytes;
+  }
+  body.resize(total);
+
+  SharedBuffer buffer = SharedBuffer::Adopt(body);
+  response->SetBody(buffer);
+
+  if (buffer.Size() == static_cast<std::size_t>(size))
+  {
+    StaticCacheEntry entry;
+    entry.file_path = file_path;
+    entry.content_type = mimeType;
+    entry.st = info.st;
+    entry.body = buffer;
+    StaticCache::Instance().Store(location, request.GetPath(), entry,
+                                  location->GetStaticCacheMaxSize());
+  }
 }
 
-std::string ResponseBuilder::GenerateDirectoryListing(
-    const std::string &path, const std::string &request_path) const
+bool ResponseBuilder::ServePrecompressed(const HttpRequest &request,
+                                         const std::string &file_path,
+                                         const std::string &content_type,
+                                         const LocationConfig *location,
+                                         HttpResponse *response) const
 {
-  std::stringstream listing;
-  listing << CreateDirectoryHeader(request_path);
+  OpenFileInfo info;
+  if (!OpenFileCache::Instance().Lookup(file_path + ".gz", *location, true, &info) ||
+      !S_ISREG(info.st.st_mode) || info.fd < 0)
+  {
+    return false;
+  }
+
+  SharedFd file(fcntl(info.fd, F_DUPFD_CLOEXEC, 0));
+  if (!file.Valid())
+  {
+    return false;
+  }
 
-  DIR *dir = opendir(path.c_str());
-  if (dir)
+  if (CheckPreconditions(request, info.st, response))
   {
-    ReadDirectoryEntries(dir, path, listing);
-    closedir(dir);
+    return true;
   }
 
-  listing << "</pre><hr></body>\n"
-          << "</html>";
-  return listing.str();
+  response->SetStatus(200, "OK");
+  response->SetHeader("Content-Type", content_type);
+  response->SetHeader("Content-Encoding", "gzip");
+  SetValidators(info.st, response);
+  response->SetBody(SharedBuffer());
+  response->AppendFile(file, 0, info.st.st_size);
+  return true;
 }
 
-void ResponseBuilder::ReadDirectoryEntries(DIR *dir,
-                                         const std::string &path,
-                                         std::stringstream &listing) const
+bool ResponseBuilder::ParseRangeHeader(const std::string &value, off_t size,
+                                       std::vector<ByteRange> *ranges) const
 {
-  struct dirent *entry;
-  while ((entry = readdir(dir)))
+  static const std::size_t kMaxRanges = 32;
+
+  if (libft::FT_ToLower(value.substr(0, 6)) != "bytes=")
   {
-    if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+    return false;
+  }
+
+  std::string::size_type pos = 6;
+  std::size_t count = 0;
+  while (pos <= value.length())
+  {
+    std::string::size_type comma = value.find(',', pos);
+    if (comma == std::string::npos)
+    {
+      comma = value.length();
+    }
+    std::string spec = libft::FT_Trim(value.substr(pos, comma - pos));
+    pos = comma + 1;
+    if (spec.empty())
     {
       continue;
     }
+    if (++count > kMaxRanges)
+    {
+      return false;
+    }
+
+    std::string::size_type dash = spec.find('-');
+    if (dash == std::string::npos)
+    {
+      return false;
+    }
+
+    off_t numbers[2] = {-1, -1};
+    std::string parts[2] = {spec.substr(0, dash), spec.substr(dash + 1)};
+    for (int i = 0; i < 2; ++i)
+    {
+      for (std::string::size_type j = 0; j < parts[i].length(); ++j)
+      {
+        if (!std::isdigit(static_cast<unsigned char>(parts[i][j])))
+        {
+          return false;
+        }
+        off_t digit = parts[i][j] - '0';
+        off_t current = numbers[i] < 0 ? 0 : numbers[i];
+        if (current > (std::numeric_limits<off_t>::max() - digit) / 10)
+        {
+          current = std::numeric_limits<off_t>::max();
+        }
+        else
+        {
+          current = current * 10 + digit;
+        }
+        numbers[i] = current;
+      }
+    }
 
-    std::string full_path = path + "/" + entry->d_name;
-    struct stat file_stat;
-    if (stat(full_path.c_str(), &file_stat) == 0)
+    ByteRange range;
+    if (numbers[0] < 0)
     {
-      listing << CreateDirectoryEntry(entry->d_name, file_stat);
+      if (numbers[1] < 0)
+      {
+        return false;
+      }
+      if (numbers[1] == 0 || size == 0)
+      {
+        continue;
+      }
+      range.first = numbers[1] >= size ? 0 : size - numbers[1];
+      range.last = size - 1;
+    }
+    else
+    {
+      if (numbers[1] >= 0 && numbers[1] < numbers[0])
+      {
+        return false;
+      }
+      if (numbers[0] >= size)
+      {
+        continue;
+      }
+      range.first = numbers[0];
+      range.last = (numbers[1] < 0 || numbers[1] >= size) ? size - 1 : numbers[1];
     }
+    ranges->push_back(range);
   }
+  return count > 0;
 }
 
-void ResponseBuilder::ServeRegularFile(const std::string &file_path,
-                                     HttpResponse *response) const
+bool ResponseBuilder::IfRangeMatches(const HttpRequest &request,
+                                     const struct stat &st) const
 {
-  struct stat file_stat;
-  if (stat(file_path.c_str(), &file_stat) != 0)
+  const std::map<std::string, std::string> &headers = request.GetHeaders();
+  std::map<std::string, std::string>::const_iterator it = headers.find("if-range");
+  if (it == headers.end())
   {
-    throw ForbiddenException();
+    return true;
   }
 
-  if (!S_ISREG(file_stat.st_mode))
+  std::string value = libft::FT_Trim(it->second);
+  if (!value.empty() && value[0] == '"')
   {
-    throw ForbiddenException();
+    return value == MakeEntityTag(st);
   }
+  std::time_t date;
+  return libft::FT_ParseHttpDate(value, &date) && date == st.st_mtime;
+}
 
-  std::ifstream file(file_path.c_str(), std::ios::binary);
-  if (!file.good())
+void ResponseBuilder::ServeRanges(const std::vector<ByteRange> &ranges,
+                                  const SharedFd &file,
+                                  const struct stat &st,
+                                  const std::string &content_type,
+                                  HttpResponse *response) const
+{
+  response->SetStatus(206, "Partial Content");
+  response->SetBody(SharedBuffer());
+
+  if (ranges.size() == 1)
   {
-    throw NotFoundException();
+    std::ostringstream content_range;
+    content_range << "bytes " << ranges[0].first << '-' << ranges[0].last
+                  << '/' << st.st_size;
+    response->SetHeader("Content-Type", content_type);
+    response->SetHeader("Content-Range", content_range.str());
+    response->AppendFile(file, ranges[0].first, ranges[0].last - ranges[0].first + 1);
+    return;
   }
 
-  response->SetStatus(200, "OK");
-
-  std::string extension = file_path.substr(file_path.find_last_of(".") + 1);
-  std::string mimeType = MimeType::GetType(extension);
-  response->SetHeader("Content-Type", mimeType);
+  static unsigned long boundary_counter = 0;
+  std::ostringstream boundary;
+  boundary << std::setw(20) << std::setfill('0') << ++boundary_counter;
+  response->SetHeader("Content-Type",
+                      "multipart/byteranges; boundary=" + boundary.str());
 
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  std::string body = buffer.str();
-  response->SetBody(body);
+  for (std::vector<ByteRange>::const_iterator it = ranges.begin();
+       it != ranges.end(); ++it)
+  {
+    std::ostringstream part;
+    part << "\r\n--" << boundary.str() << "\r\n"
+         << "Content-Type: " << content_type << "\r\n"
+         << "Content-Range: bytes " << it->first << '-' << it->last
+         << '/' << st.st_size << "\r\n\r\n";
+    response->AppendBody(SharedBuffer(part.str()));
+    response->AppendFile(file, it->first, it->last - it->first + 1);
+  }
+  response->AppendBody(SharedBuffer("\r\n--" + boundary.str() + "--\r\n"));
 }
 
 void ResponseBuilder::HandlePostRequest(const HttpRequest &request,
                                         HttpResponse *response,
                                         const ServerConfig &config)
 {
-  const LocationConfig *location = FindMatchingLocation(request, &config);
+  const LocationConfig *location = request.GetLocation();
   if (!location)
   {
     throw NotFoundException();
@@ -586,7 +1047,7 @@ void ResponseBuilder::HandleDeleteRequest(const HttpRequest &request,
                                           HttpResponse *response,
                                           const ServerConfig &config)
 {
-  const LocationConfig *location = FindMatchingLocation(request, &config);
+  const LocationConfig *location = request.GetLocation();
   if (!location)
   {
     throw NotFoundException();
@@ -601,6 +1062,7 @@ void ResponseBuilder::HandleDeleteRequest(const HttpRequest &request,
   }
 
   DeleteFile(final_path);
+  OpenFileCache::Instance().Invalidate(final_path);
 
   response->SetStatus(200, "OK");
   response->SetHeader("Content-Type", "text/plain");
@@ -633,7 +1095,7 @@ bool ResponseBuilder::HandleRedirect(const HttpRequest &request,
                                      HttpResponse *response,
                                      const ServerConfig &config)
 {
-  const LocationConfig *location = FindMatchingLocation(request, &config);
+  const LocationConfig *location = request.GetLocation();
   if (location)
   {
     const std::pair<std::string, int> &location_redirect = location->GetRedirect();
@@ -705,43 +1167,17 @@ void ResponseBuilder::BuildHeaders(int status_code)
   }
 
   response_->SetHeader("Server", "johnx/1.0.0");
-  response_->SetHeader("Date", libft::FT_GetGMTDate());
+  response_->SetHeader("Date", HttpDate::Now());
 }
 
 void ResponseBuilder::BuildBody(int status_code, const ServerConfig &config)
 {
-  const std::map<int, std::string> &error_pages = config.GetErrorPages();
-  if (!error_pages.empty())
+  const ErrorPageBody *page = config.FindErrorPage(status_code);
+  if (page)
   {
-    std::map<int, std::string>::const_iterator it = error_pages.find(status_code);
-    if (it != error_pages.end())
-    {
-      std::string file_path = config.GetRoot();
-      if (!file_path.empty() && file_path[file_path.length() - 1] != '/')
-      {
-        file_path += "/";
-      }
-      file_path += it->second;
-
-      std::ifstream file(file_path.c_str());
-      if (file.is_open())
-      {
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        response_->SetBody(buffer.str());
-
-        std::string::size_type dot_pos = it->second.find_last_of(".");
-        if (dot_pos != std::string::npos) {
-          std::string extension = it->second.substr(dot_pos + 1);
-          response_->SetHeader("Content-Type", MimeType::GetType(extension));
-        } else {
-          response_->SetHeader("Content-Type", MimeType::GetType(""));
-        }
-
-        file.close();
-        return;
-      }
-    }
+    response_->SetBody(page->body);
+    response_->SetHeader("Content-Type", page->content_type);
+    return;
   }
   BuildDefaultErrorPage(status_code);
 }
@@ -750,19 +1186,42 @@ void ResponseBuilder::BuildDefaultErrorPage(int status_code)
 {
   if (status_code >= 300)
   {
-    std::stringstream body;
-    body << "<html>\n"
-         << "<head><title>" << status_code << " "
-         << response_->GetStatusMessage() << "</title></head>\n"
-         << "<body>\n"
-         << "<center><h1>" << status_code << " "
-         << response_->GetStatusMessage() << "</h1></center>\n"
-         << "<hr><center>johnx/1.0.0</center>\n"
-         << "</body>\n"
-         << "</html>\n";
     response_->SetHeader("Content-Type", "text/html");
-    response_->SetBody(body.str());
+    response_->SetBody(DefaultErrorBody(status_code, response_->GetStatusMessage()));
+  }
+}
+
+const SharedBuffer &ResponseBuilder::DefaultErrorBody(int status_code,
+                                                      const std::string &message)
+{
+  static const std::size_t kMaxBodies = 256;
+  static std::map<std::pair<int, std::string>, SharedBuffer> bodies;
+
+  std::pair<int, std::string> key(status_code, message);
+  std::map<std::pair<int, std::string>, SharedBuffer>::iterator it = bodies.find(key);
+  if (it != bodies.end())
+  {
+    return it->second;
   }
+
+  std::stringstream body;
+  body << "<html>\n"
+       << "<head><title>" << status_code << " "
+       << message << "</title></head>\n"
+       << "<body>\n"
+       << "<center><h1>" << status_code << " "
+       << message << "</h1></center>\n"
+       << "<hr><center>johnx/1.0.0</center>\n"
+       << "</body>\n"
+       << "</html>\n";
+
+  if (bodies.size() >= kMaxBodies)
+  {
+    static SharedBuffer uncached;
+    uncached = SharedBuffer(body.str());
+    return uncached;
+  }
+  return bodies.insert(std::make_pair(key, SharedBuffer(body.str()))).first->second;
 }
 
 HttpResponse *ResponseBuilder::GetResponse()
@@ -785,6 +1244,11 @@ void ResponseDirector::ConstructResponse(const HttpRequest &request)
     try
     {
         builder_->ExecuteRequest(request);
+        if (!builder_->GetResponse()->GetIsCgiResponse())
+        {
+            GzipFilter::Apply(request.GetLocation(), GzipFilter::ClientAccepts(request),
+                              builder_->GetResponse());
+        }
         builder_->BuildHeaders(builder_->GetResponse()->GetStatusCode());
     }
     catch (const HttpException &e)
@@ -832,20 +1296,188 @@ void ResponseBuilder::HandleCgiRequest(const HttpRequest &request,
                                        const LocationConfig &location,
                                        const std::string &scriptPath)
 {
+  if (request.IsInternal())
+  {
+    throw ForbiddenException();
+  }
+
+  if (!location.GetFastCgiPass().empty())
+  {
+    HandleFastCgiRequest(request, response, location, scriptPath);
+    return;
+  }
+
   std::string executor = GetCgiExecutor(request, location);
   ValidateScriptPath(scriptPath);
 
+  bool cacheable = location.GetCgiCacheMaxSize() > 0 && CgiCache::Cacheable(request);
+  std::string cacheKey = cacheable ? CgiCache::MakeKey(request) : "";
+  if (cacheable && ServeFromCgiCache(request, response, location, executor, scriptPath, cacheKey))
+  {
+    return;
+  }
+
   ClientConnection* client = GetClientConnection(response);
+  bool limited = location.GetCgiMaxConcurrency() > 0;
+  if (limited && !client->TakeCgiSlot(&location))
+  {
+    CgiLimiter::Admission admission = CgiLimiter::Instance().Acquire(&location, client->getFd());
+    if (admission == CgiLimiter::REFUSED)
+    {
+      throw ServiceUnavailableException();
+    }
+    if (admission == CgiLimiter::QUEUED)
+    {
+      response->SetIsCgiResponse(true);
+      response->SetIsCgiProcessed(false);
+      client->WaitForCgiSlot(request, &location);
+      return;
+    }
+  }
+
+  bool locked = cacheable && location.GetCgiCacheLock() && !client->CgiCacheLockBypassed();
+  if (locked && !CgiCache::Instance().Lock(&location, cacheKey, client->getFd()))
+  {
+    response->SetIsCgiResponse(true);
+    response->SetIsCgiProcessed(false);
+    client->WaitForCgiCache(request, &location, cacheKey);
+    if (limited)
+    {
+      CgiLimiter::Instance().Release(&location);
+    }
+    return;
+  }
+
   CgiHandler *cgi = client->generateCgiHandler();
+  if (limited)
+  {
+    cgi->holdSlot(&location);
+  }
 
   SetupCgiHandler(cgi, response, executor, response->GetClientFd(), location);
-  cgi->executeCgi(*config_, request, scriptPath);
+  if (location.GetCgiPoolSize() > 0)
+  {
+    cgi->setPool(&location);
+  }
+  if (cacheable)
+  {
+    cgi->setCache(&location, cacheKey, false);
+  }
+  if (locked)
+  {
+    cgi->holdCacheLock();
+  }
+
+  try
+  {
+    cgi->executeCgi(*config_, request, scriptPath);
+  }
+  catch (...)
+  {
+    response->SetIsCgiResponse(false);
+    client->KillCgiProcess();
+    throw;
+  }
 
   client->SetCgiPid(cgi->getChildPid());
 
   RegisterCgiHandler(cgi);
 }
 
+bool ResponseBuilder::ServeFromCgiCache(const HttpRequest &request,
+                                        HttpResponse *response,
+                                        const LocationConfig &location,
+                                        const std::string &executor,
+                                        const std::string &scriptPath,
+                                        const std::string &key)
+{
+  std::time_t now = std::time(NULL);
+  bool stale = false;
+  const CgiCacheEntry *entry = CgiCache::Instance().Find(&location, key, now, &stale);
+  if (!entry)
+  {
+    return false;
+  }
+
+  response->SetStatus(entry->status, entry->reason);
+  for (std::size_t i = 0; i < entry->headers.size(); ++i)
+  {
+    response->SetHeader(entry->headers[i].first, entry->headers[i].second);
+  }
+  std::ostringstream age;
+  age << now - entry->stored;
+  response->SetHeader("Age", age.str());
+  response->SetBody(entry->body);
+
+  if (stale && CgiCache::Instance().BeginRefresh(&location, key))
+  {
+    RefreshCgiCache(request, location, executor, scriptPath, key);
+  }
+  return true;
+}
+
+// Runs the script for a stale entry with no client attached. Its output
+// only goes to the cache, and the handler deletes itself when done.
+void ResponseBuilder::RefreshCgiCache(const HttpRequest &request,
+                                      const LocationConfig &location,
+                                      const std::string &executor,
+                                      const std::string &scriptPath,
+                                      const std::string &key)
+{
+  if (location.GetCgiMaxConcurrency() > 0 &&
+      CgiLimiter::Instance().Acquire(&location, -1) != CgiLimiter::ADMITTED)
+  {
+    CgiCache::Instance().EndRefresh(&location, key);
+    return;
+  }
+
+  CgiHandler *cgi = new CgiHandler();
+  if (location.GetCgiMaxConcurrency() > 0)
+  {
+    cgi->holdSlot(&location);
+  }
+  cgi->setExecutor(executor);
+  cgi->setTimeout(location.GetCgiReadTimeout());
+  cgi->setCache(&location, key, true);
+  if (location.GetCgiPoolSize() > 0)
+  {
+    cgi->setPool(&location);
+  }
+
+  try
+  {
+    cgi->executeCgi(*config_, request, scriptPath);
+    RegisterCgiHandler(cgi);
+    cgi->watchUnattended();
+  }
+  catch (...)
+  {
+    CgiCache::Instance().EndRefresh(&location, key);
+    delete cgi;
+  }
+}
+
+void ResponseBuilder::HandleFastCgiRequest(const HttpRequest &request,
+                                           HttpResponse *response,
+                                           const LocationConfig &location,
+                                           const std::string &scriptPath)
+{
+  ValidateScriptPath(scriptPath);
+
+  ClientConnection* client = GetClientConnection(response);
+  FastCgiConnection *upstream = FastCgiClient::Instance().Start(
+      location.GetFastCgiPass(), CgiHandler::BuildEnvironment(*config_, request, scriptPath),
+      request.GetBody(), client, location.GetCgiReadTimeout());
+  if (!upstream)
+  {
+    throw BadGatewayException();
+  }
+
+  response->SetIsCgiResponse(true);
+  response->SetIsCgiProcessed(false);
+  client->AttachFastCgi(upstream);
+}
+
 std::string ResponseBuilder::GetCgiExecutor(const HttpRequest &request,
                                           const LocationConfig &location) const
 {
@@ -0,0 +1,69 @@
+#include "../../inc/Response/static_cache.h"
+
+StaticCache::StaticCache() : used_bytes_(0) {}
+
+StaticCache::~StaticCache() {}
+
+StaticCache& StaticCache::Instance() {
+  static StaticCache instance;
+  return instance;
+}
+
+bool StaticCache::IsCurrent(const StaticCacheEntry& entry, const struct stat& st) {
+  return entry.st.st_ino == st.st_ino && entry.st.st_dev == st.st_dev &&
+         entry.st.st_size == st.st_size &&
+         entry.st.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+         entry.st.st_mtim.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+const StaticCacheEntry* StaticCache::Find(const LocationConfig* location,
+                                          const std::string& request_path) {
+  std::map<Key, Node>::iterator it = entries_.find(Key(location, request_path));
+  if (it == entries_.end()) {
+    return NULL;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+  return &it->second.entry;
+}
+
+void StaticCache::Store(const LocationConfig* location, const std::string& request_path,
+                        const StaticCacheEntry& entry, std::size_t max_size) {
+  if (entry.body.Size() > max_size) {
+    return;
+  }
+
+  Key key(location, request_path);
+  std::map<Key, Node>::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    Erase(it);
+  }
+
+  while (!lru_.empty() && used_bytes_ + entry.body.Size() > max_size) {
+    Erase(entries_.find(lru_.back()));
+  }
+
+  lru_.push_front(key);
+  Node& node = entries_[key];
+  node.entry = entry;
+  node.lru = lru_.begin();
+  used_bytes_ += entry.body.Size();
+}
+
+void StaticCache::Remove(const LocationConfig* location, const std::string& request_path) {
+  std::map<Key, Node>::iterator it = entries_.find(Key(location, request_path));
+  if (it != entries_.end()) {
+    Erase(it);
+  }
+}
+
+void StaticCache::Erase(std::map<Key, Node>::iterator it) {
+  used_bytes_ -= it->second.entry.body.Size();
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+void StaticCache::Clear() {
+  entries_.clear();
+  lru_.clear();
+  used_bytes_ = 0;
+}
@@ -0,0 +1,151 @@
+#include "../../inc/Util/buffer_chain.h"
+
+#include <algorithm>
+
+const std::size_t BufferChain::npos;
+const std::size_t BufferChain::kBlockSize;
+
+BufferChain::BufferChain() : size_(0) {
+}
+
+BufferChain::BufferChain(const BufferChain& other) : size_(other.size_) {
+  other.Seal();
+  buffers_ = other.buffers_;
+}
+
+BufferChain& BufferChain::operator=(const BufferChain& other) {
+  if (this != &other) {
+    other.Seal();
+    buffers_ = other.buffers_;
+    tail_.clear();
+    size_ = other.size_;
+  }
+  return *this;
+}
+
+void BufferChain::Append(const SharedBuffer& buffer) {
+  if (buffer.Empty()) {
+    return;
+  }
+  Seal();
+  buffers_.push_back(buffer);
+  size_ += buffer.Size();
+}
+
+void BufferChain::Append(const char* data, std::size_t length) {
+  size_ += length;
+  while (length > 0) {
+    if (tail_.capacity() < kBlockSize) {
+      tail_.reserve(kBlockSize);
+    }
+    std::size_t chunk = std::min(length, kBlockSize - tail_.size());
+    tail_.append(data, chunk);
+    data += chunk;
+    length -= chunk;
+    if (tail_.size() == kBlockSize) {
+      Seal();
+    }
+  }
+}
+
+void BufferChain::Clear() {
+  buffers_.clear();
+  tail_.clear();
+  size_ = 0;
+}
+
+std::size_t BufferChain::Size() const {
+  return size_;
+}
+
+bool BufferChain::Empty() const {
+  return size_ == 0;
+}
+
+std::size_t BufferChain::Find(const std::string& needle, std::size_t from) const {
+  if (from > size_ || needle.size() > size_ - from) {
+    return npos;
+  }
+  if (needle.empty()) {
+    return from;
+  }
+  Seal();
+
+  std::size_t buffer = 0;
+  std::size_t offset = from;
+  while (offset >= buffers_[buffer].Size()) {
+    offset -= buffers_[buffer].Size();
+    ++buffer;
+  }
+
+  for (std::size_t pos = from; pos + needle.size() <= size_; ++pos) {
+    std::size_t b = buffer;
+    std::size_t o = offset;
+    std::size_t matched = 0;
+    while (matched < needle.size() && At(&b, &o) == needle[matched]) {
+      ++matched;
+    }
+    if (matched == needle.size()) {
+      return pos;
+    }
+    At(&buffer, &offset);
+  }
+  return npos;
+}
+
+std::string BufferChain::Substr(std::size_t offset, std::size_t length) const {
+  std::string out;
+  BufferChain slice = Slice(offset, length);
+  out.reserve(slice.Size());
+  for (std::size_t i = 0; i < slice.buffers_.size(); ++i) {
+    out.append(slice.buffers_[i].Data(), slice.buffers_[i].Size());
+  }
+  return out;
+}
+
+BufferChain BufferChain::Slice(std::size_t offset, std::size_t length) const {
+  Seal();
+  BufferChain slice;
+  for (std::size_t i = 0; i < buffers_.size() && length > 0; ++i) {
+    std::size_t size = buffers_[i].Size();
+    if (offset >= size) {
+      offset -= size;
+      continue;
+    }
+    SharedBuffer part = buffers_[i].Slice(offset, length);
+    slice.buffers_.push_back(part);
+    slice.size_ += part.Size();
+    if (length != npos) {
+      length -= part.Size();
+    }
+    offset = 0;
+  }
+  return slice;
+}
+
+std::size_t BufferChain::BufferCount() const {
+  Seal();
+  return buffers_.size();
+}
+
+const SharedBuffer& BufferChain::Buffer(std::size_t index) const {
+  Seal();
+  return buffers_[index];
+}
+
+void BufferChain::Seal() const {
+  if (!tail_.empty()) {
+    buffers_.push_back(SharedBuffer::Adopt(tail_));
+  }
+}
+
+// Returns the byte at (buffer, offset) and advances the position by one.
+char BufferChain::At(std::size_t* buffer, std::size_t* offset) const {
+  const SharedBuffer& current = buffers_[*buffer];
+  char c = current.Data()[*offset];
+  if (++*offset == current.Size()) {
+    *offset = 0;
+    ++*buffer;
+  }
+  return c;
+}
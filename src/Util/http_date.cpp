@@ -0,0 +1,65 @@
+#include "../../inc/Util/http_date.h"
+
+#include <cstring>
+
+std::time_t& HttpDate::CachedTime() {
+  static std::time_t cached_time = -1;
+  return cached_time;
+}
+
+std::string& HttpDate::CachedValue() {
+  static std::string cached_value;
+  return cached_value;
+}
+
+const std::string& HttpDate::Now() {
+  if (CachedTime() == -1) {
+    Update();
+  }
+  return CachedValue();
+}
+
+void HttpDate::Update() {
+  Update(std::time(0));
+}
+
+void HttpDate::Update(std::time_t now) {
+  if (now == CachedTime()) {
+    return;
+  }
+
+  static const char kDays[][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  static const char kMonths[][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+  struct tm tm;
+  gmtime_r(&now, &tm);
+
+  char buffer[30];
+  int year = tm.tm_year + 1900;
+  std::memcpy(buffer, kDays[tm.tm_wday], 3);
+  buffer[3] = ',';
+  buffer[4] = ' ';
+  buffer[5] = static_cast<char>('0' + tm.tm_mday / 10);
+  buffer[6] = static_cast<char>('0' + tm.tm_mday % 10);
+  buffer[7] = ' ';
+  std::memcpy(buffer + 8, kMonths[tm.tm_mon], 3);
+  buffer[11] = ' ';
+  buffer[12] = static_cast<char>('0' + year / 1000 % 10);
+  buffer[13] = static_cast<char>('0' + year / 100 % 10);
+  buffer[14] = static_cast<char>('0' + year / 10 % 10);
+  buffer[15] = static_cast<char>('0' + year % 10);
+  buffer[16] = ' ';
+  buffer[17] = static_cast<char>('0' + tm.tm_hour / 10);
+  buffer[18] = static_cast<char>('0' + tm.tm_hour % 10);
+  buffer[19] = ':';
+  buffer[20] = static_cast<char>('0' + tm.tm_min / 10);
+  buffer[21] = static_cast<char>('0' + tm.tm_min % 10);
+  buffer[22] = ':';
+  buffer[23] = static_cast<char>('0' + tm.tm_sec / 10);
+  buffer[24] = static_cast<char>('0' + tm.tm_sec % 10);
+  std::memcpy(buffer + 25, " GMT", 4);
+
+  CachedValue().assign(buffer, 29);
+  CachedTime() = now;
+}
@@ -1,5 +1,7 @@
 #include "../../inc/Util/libft.h"
 
+#include <cstring>
+
 namespace libft {
 
 std::string FT_Trim(const std::string& str) {
@@ -36,13 +38,35 @@ std::string FT_StrCapitalize(const std::string& str) {
 }
 
 std::string FT_GetGMTDate() {
-  std::time_t current_time = std::time(0);
+  return FT_FormatHttpDate(std::time(0));
+}
+
+std::string FT_FormatHttpDate(std::time_t time) {
   char date_buffer[50];
   std::strftime(date_buffer, sizeof(date_buffer), "%a, %d %b %Y %H:%M:%S GMT",
-                std::gmtime(&current_time));
+                std::gmtime(&time));
   return std::string(date_buffer);
 }
 
+bool FT_ParseHttpDate(const std::string& str, std::time_t* out) {
+  static const char* formats[] = {
+    "%a, %d %b %Y %H:%M:%S GMT",
+    "%A, %d-%b-%y %H:%M:%S GMT",
+    "%a %b %e %H:%M:%S %Y"
+  };
+
+  for (std::size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+    struct tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(str.c_str(), formats[i], &tm);
+    if (end && *end == '\0') {
+      *out = timegm(&tm);
+      return *out != static_cast<std::time_t>(-1);
+    }
+  }
+  return false;
+}
+
 std::string FT_Ipv4ToString(const struct in_addr& inAddr) {
   unsigned long addr = ntohl(inAddr.s_addr);
 
@@ -167,30 +167,117 @@ std::string RemoveComments(const std::string& str) {
     return result;
 }
 
+namespace {
+
+const signed char kHexValue[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+
+// Decodes a %XX escape at str[i]; returns -1 when it is not a valid one.
+int DecodeEscape(const char* str, std::size_t len, std::size_t i) {
+    if (i + 2 >= len) {
+        return -1;
+    }
+    int high = kHexValue[static_cast<unsigned char>(str[i + 1])];
+    int low = kHexValue[static_cast<unsigned char>(str[i + 2])];
+    if (high < 0 || low < 0) {
+        return -1;
+    }
+    return (high << 4) | low;
+}
+
+// Drops a trailing "." or ".." segment from out. Returns false when ".."
+// would climb above the root.
+bool ResolveLastSegment(std::string& out, std::size_t segment_start) {
+    std::size_t segment_len = out.length() - segment_start;
+
+    if (segment_len == 1 && out[segment_start] == '.') {
+        out.resize(segment_start);
+    } else if (segment_len == 2 && out[segment_start] == '.' &&
+               out[segment_start + 1] == '.') {
+        if (segment_start <= 1) {
+            return false;
+        }
+        out.resize(out.rfind('/', segment_start - 2) + 1);
+    }
+    return true;
+}
+
+}  // namespace
+
 std::string UrlDecode(const std::string& str) {
     std::string result;
-    std::string::size_type i;
-    for (i = 0; i < str.length(); ++i) {
-        if (str[i] == '%') {
-            if (i + 2 < str.length()) {
-                int value;
-                std::istringstream is(str.substr(i + 1, 2));
-                if (is >> std::hex >> value) {
-                    result += static_cast<char>(value);
-                    i += 2;
-                } else {
-                    result += str[i];
-                }
-            } else {
-                result += str[i];
+    result.reserve(str.length());
+
+    const char* data = str.data();
+    std::size_t len = str.length();
+    for (std::size_t i = 0; i < len; ++i) {
+        if (data[i] == '%') {
+            int value = DecodeEscape(data, len, i);
+            if (value >= 0) {
+                result += static_cast<char>(value);
+                i += 2;
+                continue;
             }
-        } else if (str[i] == '+') {
-            result += ' ';
-        } else {
-            result += str[i];
         }
+        result += (data[i] == '+') ? ' ' : data[i];
     }
     return result;
 }
 
+bool NormalizePath(const std::string& path, bool decode, std::string& out) {
+    const char* data = path.data();
+    std::size_t len = path.length();
+    std::size_t i = 0;
+
+    out.clear();
+    out.reserve(len);
+    if (len > 0 && data[0] == '/') {
+        out += '/';
+        ++i;
+    }
+
+    std::size_t segment_start = out.length();
+    for (; i < len; ++i) {
+        char c = data[i];
+        if (decode && c == '%') {
+            int value = DecodeEscape(data, len, i);
+            if (value == 0) {
+                return false;
+            }
+            if (value > 0) {
+                c = static_cast<char>(value);
+                i += 2;
+            }
+        }
+
+        if (c != '/') {
+            out += c;
+            continue;
+        }
+        if (!ResolveLastSegment(out, segment_start)) {
+            return false;
+        }
+        if (!out.empty() && out[out.length() - 1] != '/') {
+            out += '/';
+        }
+        segment_start = out.length();
+    }
+    return ResolveLastSegment(out, segment_start);
+}
+
 }  // namespace parsing_utils
@@ -0,0 +1,87 @@
+#include "../../inc/Util/shared_buffer.h"
+
+SharedBuffer::SharedBuffer() : block_(NULL), offset_(0), length_(0) {
+}
+
+SharedBuffer::SharedBuffer(const std::string& data) : block_(NULL), offset_(0), length_(0) {
+  if (!data.empty()) {
+    block_ = new Block();
+    block_->data = data;
+    block_->refs = 1;
+    length_ = data.size();
+  }
+}
+
+SharedBuffer::SharedBuffer(const SharedBuffer& other)
+    : block_(other.block_), offset_(other.offset_), length_(other.length_) {
+  if (block_) {
+    ++block_->refs;
+  }
+}
+
+SharedBuffer::~SharedBuffer() {
+  Release();
+}
+
+SharedBuffer& SharedBuffer::operator=(const SharedBuffer& other) {
+  if (block_ != other.block_) {
+    Release();
+    block_ = other.block_;
+    if (block_) {
+      ++block_->refs;
+    }
+  }
+  offset_ = other.offset_;
+  length_ = other.length_;
+  return *this;
+}
+
+SharedBuffer SharedBuffer::Adopt(std::string& data) {
+  SharedBuffer buffer;
+  if (!data.empty()) {
+    buffer.block_ = new Block();
+    buffer.block_->data.swap(data);
+    buffer.block_->refs = 1;
+    buffer.length_ = buffer.block_->data.size();
+  }
+  return buffer;
+}
+
+SharedBuffer SharedBuffer::Slice(std::size_t offset, std::size_t length) const {
+  SharedBuffer slice;
+  if (offset >= length_ || length == 0) {
+    return slice;
+  }
+  if (length > length_ - offset) {
+    length = length_ - offset;
+  }
+  slice = *this;
+  slice.offset_ = offset_ + offset;
+  slice.length_ = length;
+  return slice;
+}
+
+const char* SharedBuffer::Data() const {
+  return block_ ? block_->data.data() + offset_ : "";
+}
+
+std::size_t SharedBuffer::Size() const {
+  return length_;
+}
+
+bool SharedBuffer::Empty() const {
+  return length_ == 0;
+}
+
+std::string SharedBuffer::ToString() const {
+  return std::string(Data(), length_);
+}
+
+void SharedBuffer::Release() {
+  if (block_ && --block_->refs == 0) {
+    delete block_;
+  }
+  block_ = NULL;
+  offset_ = 0;
+  length_ = 0;
+}
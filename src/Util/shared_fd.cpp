@@ -0,0 +1,51 @@
+#include "../../inc/Util/shared_fd.h"
+
+#include <unistd.h>
+
+SharedFd::SharedFd() : block_(NULL) {
+}
+
+SharedFd::SharedFd(int fd) : block_(NULL) {
+  if (fd >= 0) {
+    block_ = new Block();
+    block_->fd = fd;
+    block_->refs = 1;
+  }
+}
+
+SharedFd::SharedFd(const SharedFd& other) : block_(other.block_) {
+  if (block_) {
+    ++block_->refs;
+  }
+}
+
+SharedFd::~SharedFd() {
+  Release();
+}
+
+SharedFd& SharedFd::operator=(const SharedFd& other) {
+  if (block_ != other.block_) {
+    Release();
+    block_ = other.block_;
+    if (block_) {
+      ++block_->refs;
+    }
+  }
+  return *this;
+}
+
+int SharedFd::Get() const {
+  return block_ ? block_->fd : -1;
+}
+
+bool SharedFd::Valid() const {
+  return block_ != NULL;
+}
+
+void SharedFd::Release() {
+  if (block_ && --block_->refs == 0) {
+    close(block_->fd);
+    delete block_;
+  }
+  block_ = NULL;
+}
@@ -1,7 +1,11 @@
 #include "../../inc/Web/client_connection.h"
+#include "../../inc/Cgi/cgi_cache.h"
+#include "../../inc/Cgi/cgi_limiter.h"
+#include "../../inc/Cgi/cgi_pool.h"
+#include "../../inc/Cgi/fastcgi_client.h"
 
 ClientConnection::ClientConnection(int fd, ServerConfig *config)
-    : fd_(fd), closed_(false), should_close_(false), should_delete_(false), keepalive_timeout_(60000), cgi_handler_(NULL), cgi_read_timeout_(60000), cgi_pid_(-1)
+    : fd_(fd), closed_(false), should_close_(false), should_delete_(false), write_paused_(false), keepalive_timeout_(60000), cgi_handler_(NULL), fastcgi_(NULL), cgi_read_timeout_(60000), cgi_pid_(-1), location_(NULL), accepts_gzip_(false), wait_start_(0), cgi_cache_location_(NULL), cgi_cache_lock_bypass_(false), cgi_queue_location_(NULL), cgi_slot_(NULL)
 {
   if (fcntl(fd_, F_SETFL, O_NONBLOCK) < 0)
   {
@@ -158,9 +162,10 @@ bool ClientConnection::CheckForInvalidRequest(char* buf, ssize_t n, ssize_t tota
 
 void ClientConnection::SendBadRequestResponse()
 {
+  location_ = NULL;
   director_->ConstructErrorResponse(400, "Bad Request");
   director_->GetResponse()->SetHeader("Connection", "close");
-  write_buffer_ = director_->GetResponse()->ToString();
+  QueueResponse(director_->GetResponse());
   EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
   parser_->Reset();
   response_->Clear();
@@ -200,7 +205,7 @@ void ClientConnection::SetupRequestPort(HttpRequest& req)
   req.SetPort(connected_port);
 }
 
-void ClientConnection::HandleClientRequest(const HttpRequest &request)
+void ClientConnection::HandleClientRequest(HttpRequest &request)
 {
   if (IsCgi() && cgi_handler_ && !cgi_handler_->isComplete() && !response_->GetIsCgiProcessed()) {
     return;
@@ -210,15 +215,28 @@ void ClientConnection::HandleClientRequest(const HttpRequest &request)
   director_->SetClientFd(fd_);
   director_->ConstructResponse(request);
   UpdateTimeouts(request);
+  location_ = request.GetLocation();
+  accepts_gzip_ = GzipFilter::ClientAccepts(request);
 
   if (should_close_) {
     director_->GetResponse()->SetHeader("Connection", "close");
   }
 
+  // The response is queued once the script or application server answers;
+  // until then the connection is not polled so pipelined requests stay
+  // unread.
+  if (fastcgi_ != NULL || cgi_cache_location_ != NULL || cgi_queue_location_ != NULL ||
+      (cgi_handler_ != NULL && !response_->GetIsCgiProcessed())) {
+    SaveCgiRequest(request);
+    EpollHandler::Instance().UpdateEvent(this, 0);
+    parser_->Reset();
+    return;
+  }
+
   SetupResponseForSending();
 }
 
-void ClientConnection::UpdateServerConfig(const HttpRequest &request)
+void ClientConnection::UpdateServerConfig(HttpRequest &request)
 {
   const HttpConfig* http_config = builder_->GetConfig()->GetHttpConfig();
   if (http_config) {
@@ -226,18 +244,21 @@ void ClientConnection::UpdateServerConfig(const HttpRequest &request)
     if (matched_server && matched_server != builder_->GetConfig()) {
       builder_->SetConfig(matched_server);
       parser_->SetConfig(matched_server);
+      request.SetLocation(FindMatchingLocation(request, matched_server));
     }
   }
 }
 
 void ClientConnection::UpdateTimeouts(const HttpRequest &request)
 {
-  const LocationConfig *location = FindMatchingLocation(request, builder_->GetConfig());
+  const LocationConfig *location = request.GetLocation();
   if (location)
   {
     if (IsCgi())
     {
       cgi_read_timeout_ = location->GetCgiReadTimeout();
+      if (cgi_handler_ != NULL)
+        cgi_handler_->setTimeout(cgi_read_timeout_);
     }
     keepalive_timeout_ = location->GetKeepaliveTimeout();
   }
@@ -258,6 +279,7 @@ bool ClientConnection::CheckConnectionCloseHeader(const HttpRequest &request)
 
 void ClientConnection::HandleParsingException(const HttpException &e)
 {
+  location_ = NULL;
   director_->ConstructErrorResponse(e.getStatus(), e.what());
   director_->GetResponse()->SetHeader("Connection", "close");
   should_close_ = true;
@@ -268,7 +290,7 @@ void ClientConnection::HandleParsingException(const HttpException &e)
 
 void ClientConnection::SetupResponseForSending()
 {
-  write_buffer_ = director_->GetResponse()->ToString();
+  QueueResponse(director_->GetResponse());
   EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
   parser_->Reset();
 }
@@ -278,25 +300,82 @@ void ClientConnection::HandleWrite()
   if (closed_)
     return;
 
-  if(IsCgi() && !response_->GetIsCgiProcessed())
+  UpdateActivity();
+  do
   {
-    HandleCgiTimeout();
-    return;
+    body_.Pump();
+    WriteResponseData();
+  } while (!closed_ && output_.Empty() && !body_.Done() && !body_.Throttled() && !body_.Starved());
+
+  if (!closed_ && cgi_handler_ != NULL && !CgiOutputBacklogged())
+  {
+    cgi_handler_->resumeOutput();
   }
 
-  UpdateActivity();
-  WriteResponseData();
+  if (closed_ || !output_.Empty())
+  {
+    return;
+  }
 
-  if (write_buffer_.empty())
+  if (!body_.Done())
+  {
+    PauseWriting();
+  }
+  else if (body_.Failed())
+  {
+    Close();
+  }
+  else
   {
     HandleEmptyWriteBuffer();
   }
 }
 
+// A rate-limited body that has used up its allowance stops polling for
+// EPOLLOUT; the event loop calls ResumeWriting until more bytes are due.
+void ClientConnection::PauseWriting()
+{
+  write_paused_ = true;
+  EpollHandler::Instance().UpdateEvent(this, 0);
+}
+
+void ClientConnection::ResumeWriting()
+{
+  if (write_paused_ && !closed_ && !body_.Throttled() && (!body_.Starved() || !output_.Empty()))
+  {
+    write_paused_ = false;
+    UpdateActivity();
+    EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
+  }
+}
+
 void ClientConnection::HandleCgiTimeout()
 {
+  if (cgi_cache_location_ != NULL)
+  {
+    CgiCache::Instance().CancelWait(cgi_cache_location_, cgi_cache_key_, fd_);
+    ResumeCgiCacheWait();
+    return;
+  }
+
+  if (cgi_queue_location_ != NULL)
+  {
+    CgiLimiter::Instance().CancelWait(cgi_queue_location_, fd_);
+    cgi_queue_location_ = NULL;
+    response_->SetIsCgiProcessed(true);
+    director_->ConstructErrorResponse(503, "Service Unavailable");
+    QueueResponse(response_);
+    EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
+    return;
+  }
+
   if (IsCGITimeout())
   {
+    if (response_->GetIsCgiProcessed())
+    {
+      Close();
+      return;
+    }
     KillCgiProcess();
     response_->SetStatus(504, "Gateway Timeout");
     response_->SetIsCgiProcessed(true);
@@ -304,27 +383,29 @@ void ClientConnection::HandleCgiTimeout()
     setCgiHandler(NULL);
 
     director_->ConstructErrorResponse(504, "Gateway Timeout");
-    write_buffer_ = response_->ToString();
+    QueueResponse(response_);
     EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
   }
 }
 
 void ClientConnection::WriteResponseData()
 {
-  while (!write_buffer_.empty())
+  if (!output_.Write(fd_))
   {
-    ssize_t n = write(fd_, write_buffer_.c_str(), write_buffer_.size());
-    if (n > 0)
-    {
-      write_buffer_.erase(0, n);
-    }
-    else // n = 0 or n < 0
-    {
-      break;
-    }
+    Close();
   }
 }
 
+void ClientConnection::QueueResponse(const HttpResponse *response, bool streaming)
+{
+  output_.Clear();
+  write_paused_ = false;
+  std::string head;
+  response->AppendHead(&head);
+  output_.Push(SharedBuffer::Adopt(head));
+  body_.Start(*response, location_, &output_, streaming);
+}
+
 void ClientConnection::HandleEmptyWriteBuffer()
 {
   if (should_close_)
@@ -336,6 +417,7 @@ void ClientConnection::HandleEmptyWriteBuffer()
   {
     EpollHandler::Instance().UpdateEvent(this, EPOLLIN);
   }
+  body_.Reset();
   response_->Clear();
 }
 
@@ -345,15 +427,21 @@ void ClientConnection::Close()
   {
     closed_ = true;
 
-    if (cgi_handler_ != NULL) {
-      if (cgi_handler_->isRegisteredToEpoll()) {
-        EpollHandler::Instance().UnregisterEvent(cgi_handler_);
-        cgi_handler_->setRegistered(false);
-      }
+    KillCgiProcess();
+
+    if (cgi_cache_location_ != NULL) {
+      CgiCache::Instance().CancelWait(cgi_cache_location_, cgi_cache_key_, fd_);
+      cgi_cache_location_ = NULL;
+    }
+
+    if (cgi_queue_location_ != NULL) {
+      CgiLimiter::Instance().CancelWait(cgi_queue_location_, fd_);
+      cgi_queue_location_ = NULL;
+    }
 
-      EpollHandler::Instance().InvalidateEvent(cgi_handler_);
-      EpollHandler::Instance().ScheduleForDeletion(cgi_handler_);
-      cgi_handler_ = NULL;
+    if (fastcgi_ != NULL) {
+      FastCgiClient::Instance().Cancel(fastcgi_);
+      fastcgi_ = NULL;
     }
 
     EpollHandler::Instance().UnregisterEvent(this);
@@ -364,7 +452,8 @@ void ClientConnection::Close()
     }
 
     read_buffer_.clear();
-    write_buffer_.clear();
+    output_.Clear();
+    body_.Reset();
     response_->Clear();
 
     should_close_ = false;
@@ -385,11 +474,18 @@ bool ClientConnection::IsTimedOut() const
 
 bool ClientConnection::IsCgi() const
 {
-  return cgi_handler_ != NULL;
+  return cgi_handler_ != NULL || fastcgi_ != NULL;
 }
 
 bool ClientConnection::IsCGITimeout() const
 {
+  if (cgi_cache_location_ != NULL) {
+    return (std::time(NULL) - wait_start_) * 1000 >= cgi_cache_location_->GetCgiCacheLockTimeout();
+  }
+  if (cgi_queue_location_ != NULL) {
+    return (std::time(NULL) - wait_start_) * 1000 >= cgi_queue_location_->GetCgiQueueTimeout();
+  }
+
   if (!IsCgi() || cgi_handler_ == NULL) {
     return false;
   }
@@ -401,9 +497,9 @@ bool ClientConnection::IsCGITimeout() const
   }
 }
 
-void ClientConnection::handleCgiResponse(const std::string &response)
+void ClientConnection::handleCgiResponse(const BufferChain &response)
 {
-  if (response.empty())
+  if (response.Empty())
   {
     HandleEmptyCgiResponse();
     return;
@@ -416,10 +512,12 @@ void ClientConnection::handleCgiResponse(const std::string &response)
     return;
   }
 
-  std::string::size_type headerEnd = response.find("\r\n\r\n");
-  if (headerEnd != std::string::npos)
+  std::size_t headerEnd = response.Find("\r\n\r\n");
+  if (headerEnd != BufferChain::npos)
   {
     ParseCgiHeaderAndBody(response, headerEnd);
+    if (ServeInternalRedirect())
+      return;
   }
   else
   {
@@ -429,12 +527,256 @@ void ClientConnection::handleCgiResponse(const std::string &response)
   FinalizeCgiResponse();
 }
 
+// The script's header block is complete. Its head goes out right away and
+// the body follows through handleCgiBody as the script writes it. Returns
+// false once enough output is waiting that the script should be paused.
+bool ClientConnection::handleCgiHeaders(const BufferChain &output, std::size_t headerEnd)
+{
+  if (closed_)
+    return false;
+
+  ParseCgiHeaders(output.Substr(0, headerEnd));
+  if (ServeInternalRedirect())
+    return true;
+
+  response_->SetIsCgiProcessed(true);
+  GzipFilter::ApplyStream(location_, accepts_gzip_, response_);
+
+  int status = response_->GetStatusCode();
+  bool hasBody = status >= 200 && status != 204 && status != 304;
+  if (hasBody && response_->GetHeader("Content-Length").empty() &&
+      response_->GetHeader("Transfer-Encoding").empty())
+  {
+    response_->SetHeader("Transfer-Encoding", "chunked");
+  }
+
+  QueueResponse(response_, hasBody);
+  BufferChain rest = output.Slice(headerEnd + 4);
+  for (std::size_t i = 0; i < rest.BufferCount(); ++i)
+  {
+    body_.Append(rest.Buffer(i));
+  }
+  EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
+  return !CgiOutputBacklogged();
+}
+
+bool ClientConnection::handleCgiBody(const SharedBuffer &data)
+{
+  if (closed_)
+    return false;
+
+  UpdateActivity();
+  if (body_.Streaming())
+  {
+    body_.Append(data);
+    ResumeWriting();
+  }
+  return !CgiOutputBacklogged();
+}
+
+// A script that stops before finishing cannot be reported with an error
+// status any more, so the connection is dropped and the client sees a
+// truncated body.
+void ClientConnection::handleCgiEnd(bool complete)
+{
+  if (closed_)
+    return;
+
+  if (!complete)
+  {
+    Close();
+    return;
+  }
+  body_.End();
+  ResumeWriting();
+}
+
+bool ClientConnection::CgiOutputBacklogged() const
+{
+  return output_.Pending() + body_.Buffered() >= kCgiOutputLimit;
+}
+
+void ClientConnection::AttachFastCgi(FastCgiConnection *upstream)
+{
+  fastcgi_ = upstream;
+}
+
+void ClientConnection::HandleFastCgiResponse(int status, const BufferChain &response)
+{
+  fastcgi_ = NULL;
+  if (closed_)
+    return;
+
+  if (status != 200)
+  {
+    response_->SetIsCgiProcessed(true);
+    director_->ConstructErrorResponse(status, status == 504 ? "Gateway Timeout" : "Bad Gateway");
+    QueueResponse(response_);
+    EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
+    return;
+  }
+
+  handleCgiResponse(response);
+}
+
+// Another request is already running the script for this cache key. The
+// request is kept and run again once that run finishes, or once the lock
+// timeout passes, and then either finds the new entry or runs the script
+// itself.
+void ClientConnection::WaitForCgiCache(const HttpRequest &request, const LocationConfig *location,
+                                       const std::string &key)
+{
+  waiting_request_ = request;
+  wait_start_ = std::time(NULL);
+  cgi_cache_location_ = location;
+  cgi_cache_key_ = key;
+}
+
+void ClientConnection::ResumeCgiCacheWait()
+{
+  if (closed_ || cgi_cache_location_ == NULL)
+    return;
+
+  cgi_cache_location_ = NULL;
+  cgi_cache_lock_bypass_ = true;
+  RetryWaitingRequest();
+  cgi_cache_lock_bypass_ = false;
+}
+
+bool ClientConnection::CgiCacheLockBypassed() const
+{
+  return cgi_cache_lock_bypass_;
+}
+
+// The location is at its cgi_max_concurrency. The request waits in the
+// location's queue until a running script hands its slot over, or is
+// answered with 503 once cgi_queue_timeout passes.
+void ClientConnection::WaitForCgiSlot(const HttpRequest &request, const LocationConfig *location)
+{
+  waiting_request_ = request;
+  wait_start_ = std::time(NULL);
+  cgi_queue_location_ = location;
+}
+
+// Returns whether the retried request kept the slot for its script. If it
+// did not, for example because the script's output is now cached, the
+// limiter offers the slot to the next waiter.
+bool ClientConnection::ResumeCgiSlotWait(const LocationConfig *location)
+{
+  if (closed_ || cgi_queue_location_ != location)
+    return false;
+
+  cgi_queue_location_ = NULL;
+  cgi_slot_ = location;
+  RetryWaitingRequest();
+  bool kept = cgi_slot_ == NULL;
+  cgi_slot_ = NULL;
+  return kept;
+}
+
+bool ClientConnection::TakeCgiSlot(const LocationConfig *location)
+{
+  if (cgi_slot_ != location)
+    return false;
+
+  cgi_slot_ = NULL;
+  return true;
+}
+
+void ClientConnection::RetryWaitingRequest()
+{
+  HttpRequest request = waiting_request_;
+  response_->Clear();
+  HandleClientRequest(request);
+}
+
+// Only what a static response needs is kept of the request a script is
+// answering, so that an X-Accel-Redirect can be served from it.
+void ClientConnection::SaveCgiRequest(const HttpRequest &request)
+{
+  cgi_request_.Reset();
+  cgi_request_.SetMethod("GET");
+  cgi_request_.SetVersion(request.GetVersion());
+  cgi_request_.SetHeaders(request.GetHeaders());
+  cgi_request_.SetPort(request.GetPort());
+}
+
+// A script that answers with X-Accel-Redirect (a URI) or X-Sendfile (a
+// file path under an internal location's root) has the file served by the
+// static path instead, with the client's Range and conditional headers.
+// The target must be an internal location. The script is not waited for.
+bool ClientConnection::ServeInternalRedirect()
+{
+  std::string accel = response_->GetHeader("X-Accel-Redirect");
+  std::string sendfile = response_->GetHeader("X-Sendfile");
+  if (accel.empty() && sendfile.empty())
+    return false;
+
+  static const char *kept[] = {"Set-Cookie", "Content-Disposition", "Cache-Control", "Expires"};
+  std::vector<std::pair<std::string, std::string> > headers;
+  for (std::size_t i = 0; i < sizeof(kept) / sizeof(kept[0]); ++i)
+  {
+    std::string value = response_->GetHeader(kept[i]);
+    if (!value.empty())
+      headers.push_back(std::make_pair(kept[i], value));
+  }
+
+  // A URI built from an X-Sendfile path names the file literally, so it is
+  // neither percent-decoded nor split at '?'.
+  HttpRequest request = cgi_request_;
+  std::string uri = accel;
+  bool from_file = uri.empty();
+  if (from_file && !builder_->FindInternalUri(sendfile, &uri))
+    uri.clear();
+
+  const LocationConfig *target = NULL;
+  std::string path;
+  std::string::size_type query = from_file ? std::string::npos : uri.find('?');
+  if (!uri.empty() && uri[0] == '/' &&
+      parsing_utils::NormalizePath(uri.substr(0, query), !from_file, path))
+  {
+    request.SetPath(path);
+    if (query != std::string::npos)
+      request.SetQueryString(uri.substr(query + 1));
+    target = FindMatchingLocation(request, builder_->GetConfig());
+  }
+
+  if (cgi_handler_ != NULL)
+  {
+    cgi_handler_->detachClient();
+    cgi_handler_ = NULL;
+    cgi_pid_ = -1;
+  }
+  response_->Clear();
+
+  if (target == NULL || !target->IsInternal())
+  {
+    location_ = NULL;
+    director_->ConstructErrorResponse(500, "Internal Server Error");
+  }
+  else
+  {
+    request.SetLocation(target);
+    request.SetInternal(true);
+    director_->ConstructResponse(request);
+    location_ = target;
+    for (std::size_t i = 0; i < headers.size(); ++i)
+      response_->SetHeader(headers[i].first, headers[i].second);
+  }
+
+  if (should_close_)
+    response_->SetHeader("Connection", "close");
+  QueueResponse(response_);
+  EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
+  return true;
+}
+
 void ClientConnection::HandleEmptyCgiResponse()
 {
   response_->SetStatus(500, "Internal Server Error");
   response_->SetIsCgiProcessed(true);
   director_->ConstructErrorResponse(500, "Internal Server Error");
-  write_buffer_ = response_->ToString();
+  QueueResponse(response_);
   EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
 }
 
@@ -442,17 +784,14 @@ void ClientConnection::HandleErrorCgiResponse(int status)
 {
   director_->ConstructErrorResponse(status, response_->GetStatusMessage());
   response_->SetHeader("Connection", "close");
-  write_buffer_ = response_->ToString();
+  QueueResponse(response_);
   EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
 }
 
-void ClientConnection::ParseCgiHeaderAndBody(const std::string &response, std::string::size_type headerEnd)
+void ClientConnection::ParseCgiHeaderAndBody(const BufferChain &response, std::size_t headerEnd)
 {
-  std::string headerPart = response.substr(0, headerEnd);
-  std::string bodyPart = response.substr(headerEnd + 4);
-
-  ParseCgiHeaders(headerPart);
-  response_->SetBody(bodyPart);
+  ParseCgiHeaders(response.Substr(0, headerEnd));
+  response_->SetBody(response.Slice(headerEnd + 4));
 }
 
 void ClientConnection::ParseCgiHeaders(const std::string &headerPart)
@@ -532,13 +871,13 @@ void ClientConnection::ParseNormalHeader(const std::string &line)
   }
 }
 
-void ClientConnection::HandleCgiResponseWithoutHeaderEnd(const std::string &response)
+void ClientConnection::HandleCgiResponseWithoutHeaderEnd(const BufferChain &response)
 {
-  if (response.find("<h1>500 Internal Server Error</h1>") != std::string::npos) {
+  if (response.Find("<h1>500 Internal Server Error</h1>") != BufferChain::npos) {
     response_->SetStatus(500, "Internal Server Error");
     response_->SetIsCgiProcessed(true);
     director_->ConstructErrorResponse(500, "Internal Server Error");
-  } else if (response.find("<h1>504 Gateway Timeout</h1>") != std::string::npos) {
+  } else if (response.Find("<h1>504 Gateway Timeout</h1>") != BufferChain::npos) {
     response_->SetStatus(504, "Gateway Timeout");
     response_->SetIsCgiProcessed(true);
     director_->ConstructErrorResponse(504, "Gateway Timeout");
@@ -552,7 +891,8 @@ void ClientConnection::HandleCgiResponseWithoutHeaderEnd(const std::string &resp
 void ClientConnection::FinalizeCgiResponse()
 {
   response_->SetIsCgiProcessed(true);
-  write_buffer_ = response_->ToString();
+  GzipFilter::Apply(location_, accepts_gzip_, response_);
+  QueueResponse(response_);
   EpollHandler::Instance().UpdateEvent(this, EPOLLOUT);
 }
 
@@ -565,6 +905,10 @@ void ClientConnection::KillCgiProcess()
   }
 
   if (cgi_handler_) {
+    cgi_handler_->finishCaching();
+    cgi_handler_->releaseSlot();
+    cgi_handler_->orphanChild();
+    CgiPool::Instance().Cancel(cgi_handler_);
     if (cgi_handler_->isRegisteredToEpoll()) {
       EpollHandler::Instance().UnregisterEvent(cgi_handler_);
       cgi_handler_->setRegistered(false);
@@ -591,10 +935,6 @@ void ClientConnection::setCgiHandler(CgiHandler* handler)
   if (handler) {
     handler->setClientFd(fd_);
     handler->setResponse(response_);
-    const LocationConfig *location = FindMatchingLocation(parser_->GetRequest(), builder_->GetConfig());
-    if (location) {
-      cgi_read_timeout_ = location->GetCgiReadTimeout();
-    }
     handler->setTimeout(cgi_read_timeout_);
   }
 }
@@ -1,4 +1,7 @@
 #include "../../inc/Web/epoll_handler.h"
+#include "../../inc/Util/http_date.h"
+#include "../../inc/Cgi/cgi_pool.h"
+#include "../../inc/Cgi/fastcgi_client.h"
 
 EpollHandler::EpollHandler() : epoll_fd_(-1), max_events_(0) {}
 
@@ -42,8 +45,13 @@ void EpollHandler::RunEventLoop()
       throw std::runtime_error("epoll_wait failed");
     }
 
+    HttpDate::Update();
     ProcessEvents(events, nfds);
     CleanupConnections();
+    FastCgiClient::Instance().Tick();
+    CgiPool::Instance().Tick();
+    CgiHandler::expireUnattended();
+    CgiHandler::reapOrphans();
     PerformDelayedDeletion();
   }
 }
@@ -70,7 +78,6 @@ void EpollHandler::PerformDelayedDeletion()
     }
   }
   to_be_deleted_.clear();
-  while(waitpid(-1, NULL, WNOHANG) > 0);
 }
 
 void EpollHandler::CleanupConnections()
@@ -105,6 +112,11 @@ void EpollHandler::CleanupConnections()
       }
       else
       {
+        if (conn->IsCGITimeout())
+        {
+          conn->HandleCgiTimeout();
+        }
+        conn->ResumeWriting();
         ++it;
       }
     }
@@ -0,0 +1,112 @@
+#include "../../inc/Web/output_queue.h"
+
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+OutputQueue::OutputQueue() : pending_(0) {
+}
+
+void OutputQueue::Push(const SharedBuffer& buffer) {
+  Push(buffer, 0, buffer.Size());
+}
+
+void OutputQueue::Push(const SharedBuffer& buffer, std::size_t offset, std::size_t length) {
+  if (length == 0) {
+    return;
+  }
+  Segment segment;
+  segment.buffer = buffer;
+  segment.offset = offset;
+  segment.end = offset + length;
+  segment.file_offset = 0;
+  segment.file_remaining = 0;
+  segments_.push_back(segment);
+  pending_ += length;
+}
+
+void OutputQueue::Push(const std::string& data) {
+  Push(SharedBuffer(data));
+}
+
+void OutputQueue::Push(const SharedFd& file, off_t offset, off_t length) {
+  if (length <= 0) {
+    return;
+  }
+  Segment segment;
+  segment.offset = 0;
+  segment.end = 0;
+  segment.file = file;
+  segment.file_offset = offset;
+  segment.file_remaining = length;
+  segments_.push_back(segment);
+  pending_ += length;
+}
+
+bool OutputQueue::Empty() const {
+  return segments_.empty();
+}
+
+off_t OutputQueue::Pending() const {
+  return pending_;
+}
+
+void OutputQueue::Clear() {
+  segments_.clear();
+  pending_ = 0;
+}
+
+bool OutputQueue::Write(int fd) {
+  bool would_block = false;
+
+  while (!segments_.empty() && !would_block) {
+    Segment& front = segments_.front();
+    if (front.file.Valid()) {
+      ssize_t n = sendfile(fd, front.file.Get(), &front.file_offset,
+                           static_cast<std::size_t>(front.file_remaining));
+      if (n == 0) {
+        Clear();
+        return false;
+      }
+      if (n < 0) {
+        break;
+      }
+      front.file_remaining -= n;
+      pending_ -= n;
+      if (front.file_remaining == 0) {
+        segments_.pop_front();
+      }
+    } else {
+      WriteBuffers(fd, &would_block);
+    }
+  }
+  return true;
+}
+
+void OutputQueue::WriteBuffers(int fd, bool* would_block) {
+  struct iovec iov[kMaxIov];
+  int count = 0;
+  for (std::deque<Segment>::const_iterator it = segments_.begin();
+       it != segments_.end() && count < kMaxIov && !it->file.Valid(); ++it, ++count) {
+    iov[count].iov_base = const_cast<char*>(it->buffer.Data() + it->offset);
+    iov[count].iov_len = it->end - it->offset;
+  }
+
+  ssize_t n = writev(fd, iov, count);
+  if (n <= 0) {
+    *would_block = true;
+    return;
+  }
+
+  pending_ -= n;
+  std::size_t written = static_cast<std::size_t>(n);
+  while (written > 0) {
+    Segment& front = segments_.front();
+    std::size_t remaining = front.end - front.offset;
+    if (written < remaining) {
+      front.offset += written;
+      return;
+    }
+    written -= remaining;
+    segments_.pop_front();
+  }
+}
@@ -1,4 +1,7 @@
 #include "../../inc/Web/server_manager.h"
+#include "../../inc/Cgi/cgi_pool.h"
+
+#include <csignal>
 
 ServerManager::~ServerManager() {
   for (size_t i = 0; i < servers_.size(); ++i) {
@@ -17,6 +20,10 @@ ServerManager::ServerKey ServerManager::MakeServerKey(const std::string& host,
 void ServerManager::InitServers(const HttpConfig& config) {
   try {
     EpollHandler::Instance().Init(1024);
+    CgiPool::Instance().Init(config);
+    // A script that exits before reading all of its stdin must not take
+    // the server down with it. Scripts get the default back before exec.
+    signal(SIGPIPE, SIG_IGN);
     CreateServerInstances(config);
     RegisterAndStartServers();
   } catch (const std::exception& e) {